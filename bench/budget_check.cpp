@@ -0,0 +1,158 @@
+/**
+ * @file budget_check.cpp
+ * @brief Regression: materialize() under a memory budget must not allocate
+ *        more than the budget
+ *
+ * Every operator new of the process is counted, and the peak of the live
+ * bytes above the level before materialize() is compared with the budget.
+ * On uniform data (grid prebuilt, so only the graph build is measured), for
+ * each precision, thread count and materialize_mode:
+ * - unbudgeted Buffered must peak above the budget used next (its edge lists
+ *   alone are larger, otherwise the check proves nothing);
+ * - a budget of the graph plus its fill-time working memory (degree
+ *   counters, float offsets) and a little bookkeeping must succeed, give the
+ *   unbudgeted graph and stay under it;
+ * - a budget of the bare graph must throw std::length_error, also without
+ *   ever going over it.
+ * Exits with 1 on any failure.
+ *
+ * Usage: budget_check
+ */
+
+#include "check_util.h"
+#include "spatial_grid.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Live and peak heap bytes of the whole process
+std::atomic<size_t> liveBytes{ 0 };
+std::atomic<size_t> peakBytes{ 0 };
+
+// Room for the size in front of each block, keeping malloc's alignment
+constexpr size_t HEADER = alignof(std::max_align_t);
+
+void* countedAlloc(size_t size) {
+    char* block = static_cast<char*>(std::malloc(size + HEADER));
+    if (block == nullptr) throw std::bad_alloc();
+    *reinterpret_cast<size_t*>(block) = size;
+    const size_t live = liveBytes.fetch_add(size) + size;
+    size_t peak = peakBytes.load();
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live)) {}
+    return block + HEADER;
+}
+
+void countedFree(void* pointer) {
+    if (pointer == nullptr) return;
+    char* block = static_cast<char*>(pointer) - HEADER;
+    liveBytes.fetch_sub(*reinterpret_cast<size_t*>(block));
+    std::free(block);
+}
+
+} // namespace
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* pointer) noexcept { countedFree(pointer); }
+void operator delete[](void* pointer) noexcept { countedFree(pointer); }
+void operator delete(void* pointer, size_t) noexcept { countedFree(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { countedFree(pointer); }
+
+namespace {
+
+constexpr double EXTENT = 1000.0;
+constexpr double DISTANCE = 15.0;
+constexpr size_t INSTANCES = 20000;
+// Stencil, band lists, thread pool: small, and not part of the estimate
+constexpr size_t BOOKKEEPING = 64 * 1024;
+
+InstanceStore uniform() {
+    std::mt19937_64 rng(11);
+    std::uniform_real_distribution<double> coordinate(0.0, EXTENT);
+    InstanceStore instances;
+    for (const char* name : { "A", "B", "C", "D", "E" }) instances.features.intern(name);
+    for (size_t i = 0; i < INSTANCES; ++i) {
+        instances.push_back(static_cast<FeatureType>(i % 5), static_cast<int>(i), coordinate(rng), coordinate(rng));
+    }
+    instances.sortSpatially();
+    return instances;
+}
+
+struct Outcome {
+    size_t peak;   // Above the live bytes before the call
+    bool overBudget;
+};
+
+Outcome measure(NeighborhoodMgr& neighborMgr, const InstanceStore& instances, const SpatialGrid& grid) {
+    const size_t before = liveBytes.load();
+    peakBytes.store(before);
+    bool overBudget = false;
+    try {
+        neighborMgr.materialize(instances, grid, DISTANCE);
+    } catch (const std::length_error&) {
+        overBudget = true;
+    }
+    return { peakBytes.load() - before, overBudget };
+}
+
+bool check(const InstanceStore& instances, const SpatialGrid& grid, CoordinatePrecision precision,
+           unsigned threads, MaterializeMode mode) {
+    auto manager = [&](size_t budget) {
+        NeighborhoodMgr neighborMgr;
+        neighborMgr.setThreadCount(threads);
+        neighborMgr.setCoordinatePrecision(precision);
+        neighborMgr.setMaterializeMode(mode);
+        neighborMgr.setMemoryBudget(budget);
+        return neighborMgr;
+    };
+
+    NeighborhoodMgr unbudgeted = manager(0);
+    unbudgeted.setMaterializeMode(MaterializeMode::Buffered);
+    const Outcome buffered = measure(unbudgeted, instances, grid);
+    const NeighborGraph& reference = unbudgeted.getAllNeighbors();
+
+    const size_t n = instances.size();
+    const size_t graphBytes = NeighborGraph::memoryBytesFor(n, reference.neighbors.size());
+    const size_t floatBytes = precision == CoordinatePrecision::Float ? n * 2 * sizeof(float) : 0;
+    const size_t budget = graphBytes + n * sizeof(std::uint32_t) + floatBytes + BOOKKEEPING;
+
+    NeighborhoodMgr fits = manager(budget);
+    const Outcome within = measure(fits, instances, grid);
+    NeighborhoodMgr tight = manager(graphBytes);
+    const Outcome refused = measure(tight, instances, grid);
+
+    const bool ok = buffered.peak > budget && !within.overBudget && within.peak <= budget &&
+                    check_util::sameGraph(reference, fits.getAllNeighbors()) && refused.overBudget &&
+                    refused.peak <= graphBytes;
+    std::printf("%-6s threads=%u %-9s budget=%8zu unbudgeted=%8zu within=%8zu refused(%8zu)=%8zu %s\n",
+                precision == CoordinatePrecision::Float ? "float" : "double", threads,
+                mode == MaterializeMode::Buffered ? "buffered" : "two_pass", budget, buffered.peak, within.peak,
+                graphBytes, refused.peak, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+} // namespace
+
+int main() {
+    const InstanceStore instances = uniform();
+    const SpatialGrid grid = SpatialGrid::build(instances, DISTANCE);
+
+    bool ok = true;
+    for (CoordinatePrecision precision : { CoordinatePrecision::Double, CoordinatePrecision::Float }) {
+        for (unsigned threads : { 1u, 4u }) {
+            for (MaterializeMode mode : { MaterializeMode::Buffered, MaterializeMode::TwoPass }) {
+                ok = check(instances, grid, precision, threads, mode) && ok;
+            }
+        }
+    }
+    std::printf("%s\n", ok ? "every budgeted build stayed within its budget" : "BUDGET EXCEEDED");
+    return ok ? 0 : 1;
+}
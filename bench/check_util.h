@@ -0,0 +1,80 @@
+/**
+ * @file check_util.h
+ * @brief Helpers shared by the regression checks in bench/
+ *
+ * Every check prints one line per case and exits with 1 if any case fails,
+ * so ctest only reports the verdict and the log shows where it broke. ctest
+ * runs the checks from the source directory, where the bundled datasets
+ * under data/ are found; run from elsewhere, the dataset cases are skipped
+ * instead of failing.
+ */
+
+#pragma once
+#include "data_loader.h"
+#include "instance_store.h"
+#include "neighborhood_mgr.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+
+namespace check_util {
+
+// Bundled datasets, relative to the repository root
+constexpr const char* LAS_VEGAS = "data/LasVegas_x_y_alphabet_version_03_2.csv";
+constexpr const char* SYNTHETIC_5K = "data/5k_15f_50k.csv";
+
+inline bool sameGraph(const NeighborGraph& a, const NeighborGraph& b) {
+    return a.offsets == b.offsets && a.snCount == b.snCount && a.neighbors == b.neighbors;
+}
+
+// Prints `what` when `ok` is false; returns `ok`
+inline bool report(bool ok, const std::string& what) {
+    if (!ok) std::printf("  FAILED: %s\n", what.c_str());
+    return ok;
+}
+
+// Runs `check` on the dataset at `path`, or skips it (passing) when the file
+// is not there
+template <typename Check>
+bool withDataset(const std::string& path, Check check) {
+    if (!std::ifstream(path)) {
+        std::printf("%s skipped (not found from this directory)\n", path.c_str());
+        return true;
+    }
+    return check(DataLoader::load_mapped(path));
+}
+
+// Empty store with features "A" (code 0) and "B" (code 1)
+inline InstanceStore twoFeatures() {
+    InstanceStore instances;
+    instances.features.intern("A");
+    instances.features.intern("B");
+    return instances;
+}
+
+// A at (x, y) and B at (x + dx, y + dy), both with original id `number`
+inline void pushPair(InstanceStore& instances, int number, double x, double y, double dx, double dy) {
+    instances.push_back(0, number, x, y);
+    instances.push_back(1, number, x + dx, y + dy);
+}
+
+// An A-B pair in a random direction whose length is within a relative
+// `tolerance` of `distance`, where rounding decides the neighbor test
+inline void pushPairNear(InstanceStore& instances, int number, double x, double y, double distance,
+                         double tolerance, std::mt19937_64& rng) {
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const double angle = unit(rng) * 6.283185307179586;
+    const double radius = distance * (1.0 + (unit(rng) - 0.5) * tolerance);
+    pushPair(instances, number, x, y, radius * std::cos(angle), radius * std::sin(angle));
+}
+
+// Prints the summary line and returns the exit code
+inline int finish(bool ok, const char* success) {
+    std::printf("%s\n", ok ? success : "MISMATCH");
+    return ok ? 0 : 1;
+}
+
+} // namespace check_util
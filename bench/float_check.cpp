@@ -0,0 +1,148 @@
+/**
+ * @file float_check.cpp
+ * @brief Regression: the float32 grid join must give the same graph as double
+ *
+ * CoordinatePrecision::Float tests distances on float32 offsets from the cell
+ * origin and rechecks pairs near the threshold in double. This check builds
+ * the graph both ways and requires identical CSR arrays on
+ * - pairs exactly at the neighbor distance (scaled Pythagorean triples, so
+ *   the squared distance is exact in double), each with a copy nudged one
+ *   ulp outward that must not be a neighbor;
+ * - random pairs within a relative 1e-6 of the distance, at coordinate
+ *   magnitudes 1 to 1e7 (where float32 offsets lose the most);
+ * - the bundled datasets.
+ * Both materialize modes are covered. Conventions as in check_util.h.
+ *
+ * Usage: float_check
+ */
+
+#include "check_util.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace check_util;
+
+NeighborGraph build(const InstanceStore& instances, double distance, CoordinatePrecision precision,
+                    MaterializeMode mode) {
+    NeighborhoodMgr neighborMgr;
+    neighborMgr.setCoordinatePrecision(precision);
+    neighborMgr.setMaterializeMode(mode);
+    neighborMgr.materialize(instances, distance);
+    return neighborMgr.takeGraph();
+}
+
+bool hasEdge(const NeighborGraph& graph, InstanceId from, InstanceId to) {
+    for (InstanceId neighbor : graph.neighborsOf(from)) {
+        if (neighbor == to) return true;
+    }
+    return false;
+}
+
+// Float and double graphs of `instances` in both modes; prints one line per mode
+bool compare(const char* label, const InstanceStore& instances, double distance, NeighborGraph* doubleGraph = nullptr) {
+    bool ok = true;
+    for (MaterializeMode mode : { MaterializeMode::Buffered, MaterializeMode::TwoPass }) {
+        NeighborGraph reference = build(instances, distance, CoordinatePrecision::Double, mode);
+        const NeighborGraph single = build(instances, distance, CoordinatePrecision::Float, mode);
+        const bool same = sameGraph(reference, single);
+        std::printf("%-28s d=%-10g %-9s edges double=%zu float=%zu %s\n", label, distance,
+                    mode == MaterializeMode::Buffered ? "buffered" : "two_pass", reference.edgeCount(),
+                    single.edgeCount(), same ? "same" : "DIFFERENT");
+        ok = ok && same;
+        if (doubleGraph) *doubleGraph = std::move(reference);
+    }
+    return ok;
+}
+
+// Pairs (A at p, B at p + (a, b) * d / c) for Pythagorean triples (a, b, c):
+// d is a multiple of 5 * 13 * 17 / 4, so every offset, square and sum is exact
+// in double and B sits at d exactly. Each pair is followed by one whose B is
+// one ulp farther out along its longer offset, which must not be a neighbor.
+bool exactThreshold(double origin) {
+    static const int TRIPLES[][3] = { { 3, 4, 5 }, { 5, 12, 13 }, { 8, 15, 17 }, { 1, 0, 1 }, { 0, 1, 1 } };
+    const double distance = 5 * 13 * 17 * 0.25;
+
+    InstanceStore instances = twoFeatures();
+    int number = 0;
+    for (int row = 0; row < 20; ++row) {
+        for (const auto& triple : TRIPLES) {
+            const double step = distance / triple[2];
+            for (int sign = 0; sign < 4; ++sign) {
+                const double dx = (sign & 1 ? -1 : 1) * triple[0] * step;
+                const double dy = (sign & 2 ? -1 : 1) * triple[1] * step;
+                const double y = origin + row * 4 * distance;
+                double x = origin + number * 4 * distance;
+                pushPair(instances, ++number, x, y, dx, dy);
+                x = origin + number * 4 * distance;
+                double bx = x + dx, by = y + dy;
+                double& longer = std::fabs(dx) >= std::fabs(dy) ? bx : by;
+                longer = std::nextafter(longer, (&longer == &bx ? dx : dy) < 0 ? -INFINITY : INFINITY);
+                instances.push_back(0, ++number, x, y);
+                instances.push_back(1, number, bx, by);
+            }
+        }
+    }
+
+    instances.sortSpatially();
+    NeighborGraph reference;
+    const std::string label = "exact threshold @" + std::to_string(static_cast<long long>(origin));
+    bool ok = compare(label.c_str(), instances, distance, &reference);
+
+    // The check only means something if the pairs really sit on both sides of d:
+    // odd numbers are the exact pairs, even numbers the nudged ones
+    std::vector<InstanceId> idA(number + 1), idB(number + 1);
+    for (InstanceId i = 0; i < instances.size(); ++i) {
+        (instances.type[i] == 0 ? idA : idB)[instances.origId[i]] = i;
+    }
+    for (int pair = 1; pair <= number; ++pair) {
+        const bool exact = pair % 2 == 1;
+        const double dx = instances.x[idB[pair]] - instances.x[idA[pair]];
+        const double dy = instances.y[idB[pair]] - instances.y[idA[pair]];
+        if ((dx * dx + dy * dy == distance * distance) != exact || hasEdge(reference, idA[pair], idB[pair]) != exact) {
+            std::printf("  pair %d: expected %s the distance\n", pair, exact ? "at" : "beyond");
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool nearThreshold(double magnitude) {
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const double distance = 37.0;
+
+    InstanceStore instances = twoFeatures();
+    for (int i = 0; i < 20000; ++i) {
+        const double x = magnitude + unit(rng) * distance * 200;
+        const double y = magnitude + unit(rng) * distance * 200;
+        pushPairNear(instances, i, x, y, distance, 1e-6 * (i % 3), rng);
+    }
+    instances.sortSpatially();
+    const std::string label = "near threshold @" + std::to_string(static_cast<long long>(magnitude));
+    return compare(label.c_str(), instances, distance);
+}
+
+bool dataset(const std::string& path, std::initializer_list<double> distances) {
+    return withDataset(path, [&](const InstanceStore& instances) {
+        bool ok = true;
+        for (double distance : distances) ok = compare(path.c_str(), instances, distance) && ok;
+        return ok;
+    });
+}
+
+} // namespace
+
+int main() {
+    bool ok = true;
+    for (double origin : { 0.0, 1024.0, 1048576.0, 1073741824.0 }) ok = exactThreshold(origin) && ok;
+    for (double magnitude : { 1.0, 1e3, 1e6, 1e7 }) ok = nearThreshold(magnitude) && ok;
+    ok = dataset(LAS_VEGAS, { 60.0, 160.0 }) && ok;
+    ok = dataset(SYNTHETIC_5K, { 20.0, 100.0 }) && ok;
+    return finish(ok, "float and double graphs match");
+}
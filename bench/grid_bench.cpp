@@ -0,0 +1,155 @@
+/**
+ * @file grid_bench.cpp
+ * @brief Grid refinement on skewed data: refinement 1..4 against a per-region optimum
+ *
+ * SpatialGrid::build() uses cells of side d (refinement 1) everywhere. On
+ * skewed data finer cells could pay in the crowded regions; this benchmark
+ * measures how much.
+ *
+ * The data is synthetic: a uniform background plus Gaussian clusters (fixed
+ * seed), once wide (about 30 points in the densest cells at the default
+ * sizes) and once tight (thousands). For each skew it materializes
+ * - the whole dataset at refinement 1..4, checking that the graphs agree;
+ * - the clusters and the background as two separate datasets, each at its
+ *   own best refinement. The sum is a lower bound for any per-cell
+ *   subdivision (it even skips the pairs between the two parts).
+ *
+ * At d = 20 and 200k instances refinement 1 is the fastest factor in every
+ * case and within about 15% of the lower bound: the plane sweep along x
+ * leaves about 6 d^2 of candidates around a point, and the stencils of
+ * k = 2..4 still cover 4 to 5 d^2 while costing more cell visits.
+ *
+ * Usage: grid_bench [neighbor_distance] [instances]
+ */
+
+#include "check_util.h"
+#include "distance_kernel.h"
+#include "instance_store.h"
+#include "neighborhood_mgr.h"
+#include "spatial_grid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+constexpr double EXTENT = 10000.0;
+constexpr unsigned FEATURES = 10;
+constexpr unsigned CLUSTERS = 20;
+constexpr unsigned MAX_REFINEMENT = 4;
+
+// `clustered` of the `count` instances go to Gaussian clusters, the rest is uniform
+void generate(size_t count, double clusteredShare, double sigma, InstanceStore& clusters,
+              InstanceStore& background) {
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> uniform(0.0, EXTENT);
+    std::uniform_int_distribution<unsigned> feature(0, FEATURES - 1);
+    std::normal_distribution<double> spread(0.0, sigma);
+
+    for (InstanceStore* store : { &clusters, &background }) {
+        for (unsigned f = 0; f < FEATURES; ++f) store->features.intern(std::string(1, static_cast<char>('A' + f)));
+    }
+    std::vector<std::pair<double, double>> centers(CLUSTERS);
+    for (auto& center : centers) center = { uniform(rng), uniform(rng) };
+
+    const size_t clustered = static_cast<size_t>(static_cast<double>(count) * clusteredShare);
+    for (size_t i = 0; i < count; ++i) {
+        const FeatureType type = static_cast<FeatureType>(feature(rng));
+        if (i < clustered) {
+            const auto& center = centers[i % CLUSTERS];
+            clusters.push_back(type, static_cast<int>(i), center.first + spread(rng), center.second + spread(rng));
+        } else {
+            background.push_back(type, static_cast<int>(i), uniform(rng), uniform(rng));
+        }
+    }
+}
+
+InstanceStore combine(const InstanceStore& a, const InstanceStore& b) {
+    InstanceStore out;
+    out.features = a.features;
+    out.reserve(a.size() + b.size());
+    for (const InstanceStore* part : { &a, &b }) {
+        for (InstanceId i = 0; i < part->size(); ++i) {
+            out.push_back(part->type[i], part->origId[i], part->x[i], part->y[i]);
+        }
+    }
+    out.sortSpatially();
+    return out;
+}
+
+// Grid build plus materialize, in ms
+double run(const InstanceStore& instances, double distance, unsigned refinement, NeighborGraph* graph = nullptr) {
+    if (instances.empty()) return 0.0;
+    const Clock::time_point start = Clock::now();
+    const SpatialGrid grid = SpatialGrid::build(instances, distance, GridLayout::Auto, refinement);
+    NeighborhoodMgr neighborMgr;
+    neighborMgr.setThreadCount(1);
+    neighborMgr.materialize(instances, grid, distance);
+    const double ms = elapsedMs(start);
+    if (graph) *graph = neighborMgr.getAllNeighbors();
+    return ms;
+}
+
+double best(const InstanceStore& instances, double distance, unsigned& chosen) {
+    double bestMs = 0.0;
+    for (unsigned k = 1; k <= MAX_REFINEMENT; ++k) {
+        const double ms = run(instances, distance, k);
+        if (k == 1 || ms < bestMs) {
+            bestMs = ms;
+            chosen = k;
+        }
+    }
+    return bestMs;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const double distance = argc > 1 ? std::atof(argv[1]) : 20.0;
+    const size_t count = argc > 2 ? static_cast<size_t>(std::atoll(argv[2])) : 200000;
+
+    std::printf("kernel=%s distance=%g instances=%zu (single thread)\n",
+                distance_kernel::name(distance_kernel::detect()), distance, count);
+    bool ok = true;
+    for (double sigma : { 150.0, 30.0 }) {
+        std::printf("\ncluster sigma %g\n", sigma);
+        std::printf("%9s %9s %9s %9s %9s %22s %6s\n", "clustered", "k=1_ms", "k=2_ms", "k=3_ms", "k=4_ms",
+                    "split_best_ms(kc,kb)", "graphs");
+        for (double share : { 0.0, 0.5, 0.8, 0.95 }) {
+            InstanceStore clusters, background;
+            generate(count, share, sigma, clusters, background);
+            const InstanceStore all = combine(clusters, background);
+            clusters.sortSpatially();
+            background.sortSpatially();
+
+            double fixed[MAX_REFINEMENT];
+            NeighborGraph reference, graph;
+            bool same = true;
+            fixed[0] = run(all, distance, 1, &reference);
+            for (unsigned k = 2; k <= MAX_REFINEMENT; ++k) {
+                fixed[k - 1] = run(all, distance, k, &graph);
+                same = same && check_util::sameGraph(reference, graph);
+            }
+            ok = ok && same;
+
+            unsigned clusterK = 1, backgroundK = 1;
+            const double splitMs = best(clusters, distance, clusterK) + best(background, distance, backgroundK);
+
+            std::printf("%9.2f %9.1f %9.1f %9.1f %9.1f %16.1f(%u,%u) %6s\n", share, fixed[0], fixed[1], fixed[2],
+                        fixed[3], splitMs, clusterK, backgroundK, same ? "same" : "DIFF");
+            std::fflush(stdout);
+        }
+    }
+    return ok ? 0 : 1;
+}
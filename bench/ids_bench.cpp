@@ -0,0 +1,91 @@
+/**
+ * @file ids_bench.cpp
+ * @brief IDS (Algorithm 2) scaling benchmark
+ *
+ * Loads a dataset (LasVegas by default) and builds enlarged copies of it by
+ * tiling the original extent side by side, with a gap wider than the neighbor
+ * distance so that no neighbors cross between tiles. The point density stays the
+ * same, so the work per instance is constant and IDS time should grow linearly
+ * with the instance count.
+ *
+ * Usage: ids_bench [dataset_path] [neighbor_distance] [max_copies]
+ */
+
+#include "data_loader.h"
+#include "distance_kernel.h"
+#include "ids_tree.h"
+#include "instance_store.h"
+#include "neighborhood_mgr.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Lay `copies` tiles of the dataset out in a row, spaced by extent + gap.
+InstanceStore tile(const InstanceStore& base, size_t copies, double gap) {
+    const auto range = std::minmax_element(base.x.begin(), base.x.end());
+    const double stride = (*range.second - *range.first) + gap;
+
+    InstanceStore out;
+    out.features = base.features;
+    out.reserve(base.size() * copies);
+    for (size_t c = 0; c < copies; ++c) {
+        for (InstanceId i = 0; i < base.size(); ++i) {
+            out.push_back(base.type[i], base.origId[i], base.x[i] + stride * static_cast<double>(c), base.y[i]);
+        }
+    }
+    out.sortSpatially();   // Ids grouped by feature again, as materialize() needs
+    return out;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string path = argc > 1 ? argv[1] : "data/LasVegas_x_y_alphabet_version_03_2.csv";
+    const double distance = argc > 2 ? std::atof(argv[2]) : 60.0;
+    const size_t maxCopies = argc > 3 ? static_cast<size_t>(std::atoi(argv[3])) : 8;
+
+    InstanceStore base = DataLoader::load_csv(path);
+    if (base.empty()) {
+        std::fprintf(stderr, "No instances loaded from '%s'\n", path.c_str());
+        return 1;
+    }
+
+    std::printf("dataset=%s instances=%zu features=%zu distance=%g kernel=%s\n",
+                path.c_str(), base.size(), base.features.size(), distance,
+                distance_kernel::name(distance_kernel::detect()));
+    std::printf("%8s %12s %14s %10s %10s %12s %16s\n",
+                "copies", "instances", "materialize_ms", "graph_mb", "ids_ms", "cliques", "ids_ns_per_inst");
+
+    for (size_t copies = 1; copies <= maxCopies; copies *= 2) {
+        InstanceStore data = tile(base, copies, 2.0 * distance);
+
+        NeighborhoodMgr neighborMgr;
+        Clock::time_point start = Clock::now();
+        neighborMgr.materialize(data, distance);
+        const double materializeMs = elapsedMs(start);
+
+        IDSTree tree(neighborMgr, data);
+        start = Clock::now();
+        std::vector<std::vector<InstanceId>> cliques = tree.run();
+        const double idsMs = elapsedMs(start);
+
+        std::printf("%8zu %12zu %14.1f %10.1f %10.1f %12zu %16.1f\n",
+                    copies, data.size(), materializeMs,
+                    static_cast<double>(neighborMgr.getAllNeighbors().memoryBytes()) / 1e6,
+                    idsMs, cliques.size(),
+                    idsMs * 1e6 / static_cast<double>(data.size()));
+    }
+    return 0;
+}
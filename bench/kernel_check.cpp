@@ -0,0 +1,187 @@
+/**
+ * @file kernel_check.cpp
+ * @brief Regression: every distance kernel this CPU supports must return the
+ *        scalar kernel's masks bit for bit, in double and in float
+ *
+ * The SIMD kernels promise the same arithmetic as the scalar loop (no FMA,
+ * see distance_kernel.h), so the grid join must not depend on the kernel
+ * detect() picks. Each kernel runs on the same blocks, at every length from 1
+ * to BLOCK and at unaligned starts (the tails are where the variants differ):
+ * - points exactly at the threshold (scaled Pythagorean triples, exact in
+ *   both precisions), each with a copy just farther out; the scalar masks
+ *   must keep the first and drop the second;
+ * - random points within a relative 1e-6 of the threshold and exact copies
+ *   of the query point, at coordinate magnitudes 1 to 1e7.
+ * For the float kernels both the "surely within" and the "uncertain" masks
+ * are compared. Exits with 1 if any mask differs.
+ *
+ * Usage: kernel_check
+ */
+
+#include "distance_kernel.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using distance_kernel::Isa;
+
+constexpr size_t MAX_START = 3;   // Unaligned starts tried for each block
+
+std::vector<Isa> supportedKernels() {
+    std::vector<Isa> kernels;
+    for (Isa isa : { Isa::Scalar, Isa::Avx2, Isa::Avx512 }) {
+        if (distance_kernel::supported(isa)) kernels.push_back(isa);
+    }
+    return kernels;
+}
+
+// Every kernel on [start, start + count) of `xs`/`ys` for every start and
+// count; returns the number of calls whose mask differs from the scalar one
+template <typename T>
+size_t compareBlocks(const std::vector<T>& xs, const std::vector<T>& ys, T px, T py, T sure, T maybe) {
+    size_t differing = 0;
+    for (size_t start = 0; start <= MAX_START; ++start) {
+        for (size_t count = 1; count <= distance_kernel::BLOCK && start + count <= xs.size(); ++count) {
+            std::uint64_t reference = 0, referenceUncertain = 0;
+            for (Isa isa : supportedKernels()) {
+                std::uint64_t mask, uncertain = 0;
+                if constexpr (sizeof(T) == sizeof(double)) {
+                    mask = distance_kernel::get(isa)(px, py, xs.data() + start, ys.data() + start, count, sure);
+                } else {
+                    mask = distance_kernel::getFloat(isa)(px, py, xs.data() + start, ys.data() + start, count, sure,
+                                                          maybe, &uncertain);
+                }
+                if (isa == Isa::Scalar) {
+                    reference = mask;
+                    referenceUncertain = uncertain;
+                } else if (mask != reference || uncertain != referenceUncertain) {
+                    std::printf("  %s differs: start %zu count %zu mask %016llx vs %016llx\n",
+                                distance_kernel::name(isa), start, count, static_cast<unsigned long long>(mask),
+                                static_cast<unsigned long long>(reference));
+                    ++differing;
+                }
+            }
+        }
+    }
+    return differing;
+}
+
+bool report(const std::string& label, size_t blocks, size_t differing) {
+    std::printf("%-36s %6zu blocks %s\n", label.c_str(), blocks, differing == 0 ? "same" : "DIFFERENT");
+    return differing == 0;
+}
+
+// Points at (a, b) * d / c from the query point for Pythagorean triples
+// (a, b, c), so the squared distance is d^2 exactly, alternating with the same
+// point moved out along its longer offset by the smallest step the offset
+// still shows. d = 5 * 13 * 17 / 4 keeps
+// every offset, square and sum exact in float as well as in double.
+template <typename T>
+bool exactThreshold(T origin) {
+    static const int TRIPLES[][3] = { { 3, 4, 5 }, { 5, 12, 13 }, { 8, 15, 17 }, { 1, 0, 1 }, { 0, 1, 1 } };
+    const T distance = static_cast<T>(5 * 13 * 17 * 0.25);
+    const T px = origin, py = origin;
+
+    std::vector<T> xs, ys;
+    while (xs.size() < distance_kernel::BLOCK + MAX_START) {
+        for (const auto& triple : TRIPLES) {
+            const T step = distance / static_cast<T>(triple[2]);
+            for (int sign = 0; sign < 4; ++sign) {
+                const T dx = static_cast<T>(sign & 1 ? -1 : 1) * static_cast<T>(triple[0]) * step;
+                const T dy = static_cast<T>(sign & 2 ? -1 : 1) * static_cast<T>(triple[1]) * step;
+                T bx = px + dx, by = py + dy;
+                xs.push_back(bx);
+                ys.push_back(by);
+                const bool alongX = std::fabs(dx) >= std::fabs(dy);
+                T& longer = alongX ? bx : by;
+                const T from = alongX ? px : py, offset = alongX ? dx : dy;
+                // Next coordinate whose offset from the query point is longer
+                // (one ulp of the coordinate may round away in the subtraction)
+                do {
+                    longer = std::nextafter(longer, offset < 0 ? -INFINITY : INFINITY);
+                } while (longer - from == offset);
+                xs.push_back(bx);
+                ys.push_back(by);
+            }
+        }
+    }
+
+    // Even positions are at d, odd ones beyond: the scalar kernel itself must
+    // see that, or the comparison proves nothing
+    const T r2 = distance * distance;
+    bool ok = true;
+    for (size_t start = 0; start + distance_kernel::BLOCK <= xs.size(); start += distance_kernel::BLOCK) {
+        std::uint64_t mask, uncertain = 0;
+        if constexpr (sizeof(T) == sizeof(double)) {
+            mask = distance_kernel::get(Isa::Scalar)(px, py, xs.data() + start, ys.data() + start,
+                                                     distance_kernel::BLOCK, r2);
+        } else {
+            mask = distance_kernel::getFloat(Isa::Scalar)(px, py, xs.data() + start, ys.data() + start,
+                                                          distance_kernel::BLOCK, r2, r2, &uncertain);
+        }
+        const std::uint64_t expected = (start % 2 == 0 ? 0x5555555555555555ull : 0xAAAAAAAAAAAAAAAAull);
+        if (mask != expected) {
+            std::printf("  scalar mask %016llx, expected %016llx\n", static_cast<unsigned long long>(mask),
+                        static_cast<unsigned long long>(expected));
+            ok = false;
+        }
+    }
+
+    // In float, `maybe` one step above d^2 puts the outward copies in the uncertain mask
+    const T maybe = std::nextafter(r2, static_cast<T>(INFINITY));
+    const std::string label = std::string(sizeof(T) == sizeof(double) ? "double" : "float") +
+                              " exact threshold @" + std::to_string(static_cast<long long>(origin));
+    return report(label, 1, compareBlocks(xs, ys, px, py, r2, maybe)) && ok;
+}
+
+// Blocks of points within a relative 1e-6 of d, and copies of the query point
+template <typename T>
+bool nearThreshold(double magnitude) {
+    std::mt19937_64 rng(13);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const double distance = 37.0;
+    // The float kernels see offsets from a cell origin, never large coordinates
+    const double base = sizeof(T) == sizeof(double) ? magnitude : 0.0;
+
+    size_t differing = 0;
+    constexpr size_t BLOCKS = 200;
+    for (size_t b = 0; b < BLOCKS; ++b) {
+        const double px = base + unit(rng) * distance * 3;
+        const double py = base + unit(rng) * distance * 3;
+        std::vector<T> xs, ys;
+        for (size_t j = 0; j < distance_kernel::BLOCK + MAX_START; ++j) {
+            const double angle = unit(rng) * 6.283185307179586;
+            const double radius = j % 7 == 0 ? 0.0 : distance * (1.0 + (unit(rng) - 0.5) * 1e-6 * (j % 3));
+            xs.push_back(static_cast<T>(px + radius * std::cos(angle)));
+            ys.push_back(static_cast<T>(py + radius * std::sin(angle)));
+        }
+        const T r2 = static_cast<T>(distance * distance);
+        const T margin = static_cast<T>(distance * distance * 1e-6);
+        differing += compareBlocks(xs, ys, static_cast<T>(px), static_cast<T>(py), r2 - margin * (b % 2), r2 + margin);
+    }
+    const std::string label = std::string(sizeof(T) == sizeof(double) ? "double" : "float") + " near threshold @" +
+                              std::to_string(static_cast<long long>(sizeof(T) == sizeof(double) ? magnitude : 0.0));
+    return report(label, BLOCKS, differing);
+}
+
+} // namespace
+
+int main() {
+    std::printf("kernels:");
+    for (Isa isa : supportedKernels()) std::printf(" %s", distance_kernel::name(isa));
+    std::printf("\n");
+
+    bool ok = true;
+    for (double origin : { 0.0, 1024.0, 1048576.0, 1073741824.0 }) ok = exactThreshold<double>(origin) && ok;
+    for (float origin : { 0.0f, 64.0f, 512.0f, 4096.0f }) ok = exactThreshold<float>(origin) && ok;
+    for (double magnitude : { 1.0, 1e3, 1e6, 1e7 }) ok = nearThreshold<double>(magnitude) && ok;
+    ok = nearThreshold<float>(0.0) && ok;
+    std::printf("%s\n", ok ? "all kernels match the scalar kernel" : "MISMATCH");
+    return ok ? 0 : 1;
+}
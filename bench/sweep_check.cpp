@@ -0,0 +1,108 @@
+/**
+ * @file sweep_check.cpp
+ * @brief Regression: DistanceSweep::graphAt(d) must equal a fresh materialize() at d
+ *
+ * For each dataset, one sweep is built at the largest distance and every
+ * distance of the list, from the smallest to that maximum, is cut from it and
+ * compared with the CSR arrays of a NeighborhoodMgr materialized at that
+ * distance alone. The datasets are
+ * - pairs exactly at each distance of the list and one ulp beyond it, plus
+ *   random pairs within a relative 1e-6 of each distance (where the float
+ *   edge lengths of the sweep must be rechecked in double);
+ * - the bundled datasets.
+ * Distances outside (0, maxDistance()] must be rejected. Conventions as in
+ * check_util.h.
+ *
+ * Usage: sweep_check
+ */
+
+#include "check_util.h"
+#include "distance_sweep.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace check_util;
+
+bool rejects(const DistanceSweep& sweep, double distance) {
+    try {
+        sweep.graphAt(distance);
+    } catch (const std::invalid_argument&) {
+        return true;
+    }
+    std::printf("  graphAt(%g) was accepted\n", distance);
+    return false;
+}
+
+// One sweep at the largest of `distances`, every distance compared with materialize()
+bool compare(const char* label, const InstanceStore& instances, const std::vector<double>& distances) {
+    const double maxDistance = *std::max_element(distances.begin(), distances.end());
+    NeighborhoodMgr sweepMgr;
+    const DistanceSweep sweep(sweepMgr, instances, maxDistance);
+
+    bool ok = true;
+    for (double distance : distances) {
+        NeighborhoodMgr neighborMgr;
+        neighborMgr.materialize(instances, distance);
+        const NeighborGraph cut = sweep.graphAt(distance);
+        const bool same = sameGraph(cut, neighborMgr.getAllNeighbors());
+        std::printf("%-44s max=%-8g d=%-8g edges sweep=%zu materialize=%zu %s\n", label, maxDistance, distance,
+                    cut.edgeCount(), neighborMgr.getAllNeighbors().edgeCount(), same ? "same" : "DIFFERENT");
+        ok = ok && same;
+    }
+    ok = rejects(sweep, 0.0) && ok;
+    ok = rejects(sweep, -1.0) && ok;
+    ok = rejects(sweep, std::nextafter(maxDistance, INFINITY)) && ok;
+    return ok;
+}
+
+// For each distance: axis-aligned pairs at exactly d and one ulp beyond, and
+// random pairs within a relative 1e-6 of d
+bool thresholds(const std::vector<double>& distances) {
+    std::mt19937_64 rng(11);
+    const double spacing = 4 * *std::max_element(distances.begin(), distances.end());
+
+    InstanceStore instances = twoFeatures();
+    int number = 0;
+    for (double distance : distances) {
+        for (int k = 0; k < 200; ++k) {
+            const double x = 1000.0 + (number % 100) * spacing;
+            const double y = 1000.0 + (number / 100) * spacing;
+            ++number;
+            switch (k % 4) {
+            case 0:   // Exactly at d
+                pushPair(instances, number, x, y, distance, 0.0);
+                break;
+            case 1:   // One ulp beyond d
+                instances.push_back(0, number, x, y);
+                instances.push_back(1, number, x, std::nextafter(y + distance, INFINITY));
+                break;
+            default:
+                pushPairNear(instances, number, x, y, distance, 1e-6, rng);
+            }
+        }
+    }
+    instances.sortSpatially();
+    return compare("pairs at each threshold", instances, distances);
+}
+
+bool dataset(const std::string& path, const std::vector<double>& distances) {
+    return withDataset(path, [&](const InstanceStore& instances) { return compare(path.c_str(), instances, distances); });
+}
+
+} // namespace
+
+int main() {
+    bool ok = true;
+    ok = thresholds({ 0.5, 7.0, 20.0, 37.5, 60.0 }) && ok;
+    ok = dataset(LAS_VEGAS, { 1.0, 20.0, 47.5, 60.0, 100.0, 160.0 }) && ok;
+    ok = dataset(SYNTHETIC_5K, { 0.25, 5.0, 20.0, 50.0, 100.0 }) && ok;
+    return finish(ok, "sweep graphs match materialize");
+}
@@ -0,0 +1,105 @@
+/**
+ * @file tile_check.cpp
+ * @brief Regression: tile-by-tile IDS must give the cliques of IDSTree::run()
+ *        over the whole dataset
+ *
+ * Each dataset is cut into many tiles twice, by TiledNeighborhood::partition()
+ * from the loaded store and from a snapshot of it read in place, and each
+ * split is materialized and searched tile by tile. Both must
+ * - give every instance to exactly one tile core, with at most tile_points
+ *   core instances per tile;
+ * - return from runIds() the cliques of IDSTree::run() on the global graph,
+ *   in the same order.
+ * The first dataset is large enough for the snapshot split to sample its
+ * medians (more rows than TiledNeighborhood::SAMPLE_MIN); one run also sets
+ * a memory budget below the largest tile, so materialize() splits tiles
+ * again. The bundled Las Vegas data is the third dataset. Conventions as in
+ * check_util.h.
+ *
+ * Usage: tile_check
+ */
+
+#include "check_util.h"
+#include "ids_tree.h"
+#include "tiled_neighborhood.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace check_util;
+
+InstanceStore uniform(size_t count, double extent) {
+    std::mt19937_64 rng(17);
+    std::uniform_real_distribution<double> coordinate(0.0, extent);
+    InstanceStore instances;
+    for (const char* name : { "A", "B", "C", "D", "E" }) instances.features.intern(name);
+    for (size_t i = 0; i < count; ++i) {
+        instances.push_back(static_cast<FeatureType>(i % 5), static_cast<int>(i), coordinate(rng), coordinate(rng));
+    }
+    instances.sortSpatially();
+    return instances;
+}
+
+// One split of `instances` (from the store or from `snapshot`) against `expected`
+bool tiled(const char* label, const InstanceStore& instances, const std::string& snapshot, double distance,
+           size_t tilePoints, size_t budget, const std::vector<std::vector<InstanceId>>& expected) {
+    const std::string directory = (std::filesystem::temp_directory_path() / "tile_check").string();
+    TiledNeighborhood tiles(directory, distance, tilePoints);
+    if (snapshot.empty()) tiles.partition(instances);
+    else tiles.partition(snapshot);
+
+    NeighborhoodMgr neighborMgr;
+    neighborMgr.setMaterializeMode(MaterializeMode::TwoPass);
+    neighborMgr.setMemoryBudget(budget);
+    tiles.materialize(neighborMgr);
+
+    size_t cores = 0;
+    bool fits = true;
+    for (const TiledNeighborhood::Tile& tile : tiles.tiles()) {
+        cores += tile.corePoints;
+        fits = fits && tile.corePoints <= tilePoints;
+    }
+    const std::vector<std::vector<InstanceId>> cliques = tiles.runIds();
+    const bool same = cliques == expected;
+    std::printf("%-28s %-9s budget=%-9zu %4zu tiles, %zu cliques %s\n", label, snapshot.empty() ? "store" : "snapshot",
+                budget, tiles.tiles().size(), cliques.size(), same ? "same as IDSTree::run" : "DIFFERENT");
+
+    bool ok = report(tiles.tiles().size() > 1, "split into several tiles");
+    ok = report(fits && cores == instances.size(), "every instance in one core, cores within tile_points") && ok;
+    tiles.removeFiles();
+    std::filesystem::remove_all(directory);
+    return same && ok;
+}
+
+bool compare(const char* label, const InstanceStore& instances, double distance, size_t tilePoints,
+             size_t budget = 0) {
+    NeighborhoodMgr neighborMgr;
+    neighborMgr.materialize(instances, distance);
+    const std::vector<std::vector<InstanceId>> expected = IDSTree(neighborMgr, instances).run();
+
+    const std::string snapshot = (std::filesystem::temp_directory_path() / "tile_check.cbin").string();
+    DataLoader::save_snapshot(instances, snapshot);
+    bool ok = tiled(label, instances, "", distance, tilePoints, 0, expected);
+    ok = tiled(label, instances, snapshot, distance, tilePoints, 0, expected) && ok;
+    if (budget != 0) ok = tiled(label, instances, snapshot, distance, tilePoints, budget, expected) && ok;
+    std::filesystem::remove(snapshot);
+    return ok;
+}
+
+} // namespace
+
+int main() {
+    bool ok = true;
+    // About 5 neighbors per instance; the budget fits roughly half a tile's graph
+    ok = compare("uniform 150k", uniform(150000, 3000.0), 10.0, 5000, NeighborGraph::memoryBytesFor(3000, 15000)) && ok;
+    ok = compare("uniform 20k, dense", uniform(20000, 500.0), 10.0, 1500) && ok;
+    ok = withDataset(LAS_VEGAS, [](const InstanceStore& instances) {
+        return compare("LasVegas", instances, 60.0, 3000);
+    }) && ok;
+    return finish(ok, "tiled cliques match IDSTree::run");
+}
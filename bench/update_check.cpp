@@ -0,0 +1,197 @@
+/**
+ * @file update_check.cpp
+ * @brief Regression: NeighborhoodMgr::update() must give the graph and store a
+ *        full materialize() gives on the same final data
+ *
+ * Each scenario materializes a store, then applies a few rounds of removals
+ * (with repeats) and insertions: instances of existing features, of new
+ * feature names that sort before, between and after the existing ones, exact
+ * copies of existing points and points exactly one neighbor distance away.
+ * After every round it requires
+ * - the patched graph to equal, array for array, a fresh materialize() of the
+ *   updated store;
+ * - feature codes in name order, rows grouped by code (featureMajor) and
+ *   spatiallyOrdered cleared;
+ * - remap and inserted to point at the right rows, and changed to list exactly
+ *   the rows whose neighbors differ;
+ * - a snapshot of the updated store to load back in the same row order.
+ * Scenarios: uniform data with codes in name order, the same with codes out of
+ * name order (every row has to be resorted), and the bundled Las Vegas data.
+ * Conventions as in check_util.h.
+ *
+ * Usage: update_check
+ */
+
+#include "check_util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace check_util;
+
+bool sameRows(const InstanceStore& a, const InstanceStore& b) {
+    return a.x == b.x && a.y == b.y && a.type == b.type && a.origId == b.origId;
+}
+
+// Rows whose neighbors differ from the old row mapped through `update`
+std::vector<InstanceId> expectedChanged(const NeighborGraph& before, const NeighborGraph& after,
+                                        const NeighborUpdate& update) {
+    std::vector<InstanceId> origin(after.size(), INVALID_INSTANCE);
+    for (InstanceId i = 0; i < update.remap.size(); ++i) {
+        if (update.remap[i] != INVALID_INSTANCE) origin[update.remap[i]] = i;
+    }
+    std::vector<InstanceId> changed;
+    for (InstanceId id = 0; id < after.size(); ++id) {
+        if (origin[id] == INVALID_INSTANCE) {
+            changed.push_back(id);
+            continue;
+        }
+        std::vector<InstanceId> mapped;
+        bool lost = false;
+        for (InstanceId other : before.neighborsOf(origin[id])) {
+            if (update.remap[other] == INVALID_INSTANCE) lost = true;
+            else mapped.push_back(update.remap[other]);
+        }
+        std::sort(mapped.begin(), mapped.end());
+        const InstanceSpan row = after.neighborsOf(id);
+        if (lost || mapped != std::vector<InstanceId>(row.begin(), row.end())) changed.push_back(id);
+    }
+    return changed;
+}
+
+// One batch of removals and insertions around the current store
+void makeBatch(const InstanceStore& instances, double distance, std::mt19937_64& rng, size_t count,
+               std::vector<InstanceId>& removed, InstanceStore& added) {
+    static const char* NEW_NAMES[] = { "0NEW", "CNEW", "ZZNEW" };
+    std::uniform_real_distribution<double> ux(instances.bounds.minX, instances.bounds.maxX);
+    std::uniform_real_distribution<double> uy(instances.bounds.minY, instances.bounds.maxY);
+    std::uniform_int_distribution<size_t> any(0, instances.size() - 1);
+
+    removed.clear();
+    for (size_t k = 0; k < count; ++k) removed.push_back(static_cast<InstanceId>(any(rng)));
+    removed.push_back(removed.front());   // Repeats are allowed
+
+    for (size_t k = 0; k < count; ++k) {
+        const InstanceId near = static_cast<InstanceId>(any(rng));
+        const std::string name = k % 10 == 0 ? NEW_NAMES[k / 10 % 3]
+                                             : instances.features.name(instances.type[any(rng)]);
+        const FeatureType type = added.features.intern(name);
+        const int number = 1000000 + static_cast<int>(k);
+        switch (k % 4) {
+        case 0: added.push_back(type, number, ux(rng), uy(rng)); break;
+        case 1: added.push_back(type, number, instances.x[near], instances.y[near]); break;
+        case 2: added.push_back(type, number, instances.x[near] + distance, instances.y[near]); break;
+        default: added.push_back(type, number, instances.x[near] + distance * 0.5, instances.y[near] - distance * 0.25);
+        }
+    }
+}
+
+bool scenario(const char* label, InstanceStore instances, double distance, size_t batch) {
+    bool ok = true;
+    NeighborhoodMgr neighborMgr;
+    neighborMgr.materialize(instances, distance);
+    std::mt19937_64 rng(5);
+    const std::string snapshot = (std::filesystem::temp_directory_path() / "update_check.cbin").string();
+
+    for (int round = 1; round <= 3; ++round) {
+        std::vector<InstanceId> removed;
+        InstanceStore added;
+        makeBatch(instances, distance, rng, batch, removed, added);
+        const InstanceStore before = instances;
+        const NeighborGraph beforeGraph = neighborMgr.getAllNeighbors();
+
+        const NeighborUpdate update = neighborMgr.update(instances, removed, added, distance);
+        NeighborhoodMgr fresh;
+        fresh.materialize(instances, distance);
+        const bool same = sameGraph(neighborMgr.getAllNeighbors(), fresh.getAllNeighbors());
+        std::printf("%-28s round %d: %zu instances, %zu edges, %zu changed rows, %s\n", label, round,
+                    instances.size(), fresh.getAllNeighbors().edgeCount(), update.changed.size(),
+                    same ? "same as materialize" : "DIFFERENT from materialize");
+        ok = ok && same;
+
+        bool namesInOrder = true;
+        for (size_t c = 1; c < instances.features.size(); ++c) {
+            namesInOrder = namesInOrder && instances.features.name(static_cast<FeatureType>(c - 1)) <
+                                               instances.features.name(static_cast<FeatureType>(c));
+        }
+        ok = report(namesInOrder, "feature codes follow name order") && ok;
+        ok = report(instances.featureMajor && !instances.spatiallyOrdered &&
+                        std::is_sorted(instances.type.begin(), instances.type.end()),
+                    "rows feature-major, not claimed spatially ordered") && ok;
+
+        bool rowsCarried = true;
+        for (InstanceId i = 0; i < before.size(); ++i) {
+            const InstanceId id = update.remap[i];
+            if (id == INVALID_INSTANCE) continue;
+            rowsCarried = rowsCarried && instances.x[id] == before.x[i] && instances.y[id] == before.y[i] &&
+                          instances.origId[id] == before.origId[i] &&
+                          instances.features.name(instances.type[id]) == before.features.name(before.type[i]);
+        }
+        for (size_t j = 0; j < added.size(); ++j) {
+            const InstanceId id = update.inserted[j];
+            rowsCarried = rowsCarried && instances.x[id] == added.x[j] && instances.y[id] == added.y[j] &&
+                          instances.features.name(instances.type[id]) == added.features.name(added.type[j]);
+        }
+        ok = report(rowsCarried, "remap and inserted point at the moved rows") && ok;
+        ok = report(update.changed == expectedChanged(beforeGraph, neighborMgr.getAllNeighbors(), update),
+                    "changed lists exactly the rows whose neighbors differ") && ok;
+
+        DataLoader::save_snapshot(instances, snapshot);
+        const InstanceStore reloaded = DataLoader::load_snapshot(snapshot);
+        ok = report(sameRows(reloaded, instances) && reloaded.featureMajor && !reloaded.spatiallyOrdered,
+                    "snapshot reloads in the same row order") && ok;
+    }
+    std::filesystem::remove(snapshot);
+    return ok;
+}
+
+InstanceStore uniform(bool codesInNameOrder) {
+    static const char* NAMES[] = { "B", "D", "F", "H", "J" };
+    InstanceStore instances;
+    if (codesInNameOrder) {
+        for (const char* name : NAMES) instances.features.intern(name);
+    } else {
+        for (int k = 4; k >= 0; --k) instances.features.intern(NAMES[k]);   // "J" gets code 0
+    }
+    std::mt19937_64 rng(3);
+    std::uniform_real_distribution<double> coordinate(0.0, 1000.0);
+    for (int i = 0; i < 20000; ++i) {
+        instances.push_back(static_cast<FeatureType>(i % 5), i, coordinate(rng), coordinate(rng));
+    }
+    instances.sortSpatially();
+    return instances;
+}
+
+bool rejectsUnordered() {
+    InstanceStore instances = uniform(true);
+    NeighborhoodMgr neighborMgr;
+    neighborMgr.materialize(instances, 10.0);
+    instances.push_back(0, -1, 1.0, 1.0);   // No longer feature-major
+    neighborMgr.setGraph(NeighborGraph());
+    try {
+        neighborMgr.update(instances, {}, InstanceStore(), 10.0);
+    } catch (const std::invalid_argument&) {
+        return true;
+    }
+    return report(false, "update() on a store that is not feature-major must throw");
+}
+
+} // namespace
+
+int main() {
+    bool ok = true;
+    ok = scenario("uniform", uniform(true), 10.0, 500) && ok;
+    ok = scenario("uniform, codes unordered", uniform(false), 10.0, 500) && ok;
+    ok = withDataset(LAS_VEGAS, [](const InstanceStore& instances) {
+        return scenario("LasVegas", instances, 60.0, 1000);
+    }) && ok;
+    ok = rejectsUnordered() && ok;
+    return finish(ok, "update matches materialize");
+}
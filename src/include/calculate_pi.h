@@ -1,24 +1,33 @@
-﻿/**
- * @file calculate_pi.h
- * @brief Calculate PI value (Algorithm 6)
- *
- * File này định nghĩa lớp tính toán PI, tuân thủ tuyệt đối các bước,
- * tên biến và logic trong Algorithm 6.
- */
-
-#pragma once
-
-#include "types.h"
-#include "candidate_generation.h" // Để sử dụng CHash và FeatureBucket
-#include <vector>
-#include <map>
-#include <unordered_set>
-#include <algorithm>
-
-class CalculatePI {
-public:
-	std::vector<std::vector<SpatialInstance>> calculatePI(
-		const CHashStructure& chash,
-		const PatternKey& candidate
-	);
+﻿/**
+ * @file calculate_pi.h
+ * @brief Calculate PI value (Algorithm 6)
+ *
+ * File này định nghĩa lớp tính toán PI, tuân thủ tuyệt đối các bước,
+ * tên biến và logic trong Algorithm 6.
+ */
+
+#pragma once
+
+#include "types.h"
+#include "candidate_generation.h" // Để sử dụng CHash và FeatureBucket
+#include <vector>
+#include <map>
+#include <unordered_set>
+#include <algorithm>
+
+class CalculatePI {
+public:
+	/**
+	 * @brief Instance tham gia của từng feature trong candidate
+	 *
+	 * Mỗi khóa của C-Hash gom các clique cực đại cùng tập feature, nên row
+	 * instance của candidate là phần chiếu lên candidate của các clique có khóa
+	 * chứa candidate. Cột i của kết quả là các instance khác nhau (tăng dần)
+	 * của feature candidate[i] trong các khóa đó; PI lấy từ kích thước các cột.
+	 * Mọi cột rỗng nếu không khóa nào chứa candidate.
+	 */
+	std::vector<std::vector<InstanceId>> calculatePI(
+		const CHashStructure& chash,
+		const PatternKey& candidate
+	);
 };
\ No newline at end of file
@@ -1,41 +1,59 @@
-﻿/**
- * @file candidate_generation.h
- * @brief Candidate Generation (Algorithm 4)
- *
- * File này định nghĩa cấu trúc CHash và lớp xử lý để tuân thủ tuyệt đối
- * các bước và tên hàm trong Algorithm 4.
- */
-
-#pragma once
-
-#include "types.h"
-#include <vector>
-#include <map>
-#include <string>
-#include "ids_tree.h"
-
- // Key cho bảng băm: Là tập hợp các Feature đã sắp xếp (ví dụ: {A, B, C}
-using PatternKey = std::vector<FeatureType>;
-
-// Cấu trúc lưu trữ dữ liệu cho một mẫu (Key) cụ thể
-// Tương ứng với cấu trúc bên trong chash[newKey]
-struct PatternInstanceTable {
-    // Map từ Feature -> Danh sách các Instance ID (Cột)
-    // Ví dụ: Feature A -> [A1, A10, A20], Feature B -> [B2, B11, B21]
-    std::map<FeatureType, std::vector<SpatialInstance>> feature_columns;
-
-    // Dòng 6: chash[newKey][f].AddInstances(cl)
-    // Hàm này thêm instance ID thích hợp vào cột tương ứng với feature f
-    void AddInstance(FeatureType f, SpatialInstance instance) {
-        feature_columns[f].push_back(instance);
-    }
-};
-
-using CHashStructure = std::map<PatternKey, PatternInstanceTable>;
-
-class CandidateGenerator{
-private:
-    PatternKey GetFeatures(const std::vector<SpatialInstance>& clique);
-public:
-    CHashStructure Candidate_generation(const std::vector<std::vector<SpatialInstance>>& cls);
+﻿/**
+ * @file candidate_generation.h
+ * @brief Candidate Generation (Algorithm 4)
+ *
+ * File này định nghĩa cấu trúc CHash và lớp xử lý để tuân thủ tuyệt đối
+ * các bước và tên hàm trong Algorithm 4.
+ */
+
+#pragma once
+
+#include "types.h"
+#include "instance_store.h"
+#include <vector>
+#include <map>
+#include <string>
+#include <cstddef>
+#include "ids_tree.h"
+
+ // Key cho bảng băm: Là tập hợp các mã Feature đã sắp xếp (ví dụ: {A, B, C} -> {0, 1, 2})
+using PatternKey = std::vector<FeatureType>;
+
+// Hàm băm cho PatternKey (dùng cho các unordered_map theo mẫu)
+struct PatternKeyHash {
+    std::size_t operator()(const PatternKey& key) const noexcept {
+        std::size_t h = key.size();
+        for (FeatureType f : key) {
+            h ^= static_cast<std::size_t>(f) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        }
+        return h;
+    }
+};
+
+// Cấu trúc lưu trữ dữ liệu cho một mẫu (Key) cụ thể
+// Tương ứng với cấu trúc bên trong chash[newKey]
+struct PatternInstanceTable {
+    // Map từ Feature -> Danh sách các Instance ID (Cột)
+    // Ví dụ: Feature A -> [A1, A10, A20], Feature B -> [B2, B11, B21]
+    std::map<FeatureType, std::vector<InstanceId>> feature_columns;
+
+    // Dòng 6: chash[newKey][f].AddInstances(cl)
+    // Hàm này thêm instance ID thích hợp vào cột tương ứng với feature f
+    void AddInstance(FeatureType f, InstanceId instance) {
+        feature_columns[f].push_back(instance);
+    }
+};
+
+using CHashStructure = std::map<PatternKey, PatternInstanceTable>;
+
+class CandidateGenerator{
+private:
+    // instances: tập S, dùng để tra feature (cột type[]) của từng id trong clique
+    PatternKey GetFeatures(const std::vector<InstanceId>& clique, const InstanceStore& instances);
+public:
+    CHashStructure Candidate_generation(const std::vector<std::vector<InstanceId>>& cls, const InstanceStore& instances);
+
+    // Dòng 2-7 cho một clique: thêm cl vào chash (dùng khi các clique đến
+    // dần, ví dụ từng tile một, không cần giữ cả danh sách cls)
+    void AddClique(const std::vector<InstanceId>& cl, const InstanceStore& instances, CHashStructure& chash);
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+/**
+ * @file cbin_format.h
+ * @brief On-disk layout of the binary columnar dataset snapshot (.cbin)
+ *
+ * A snapshot holds an InstanceStore exactly as it is after loading: final
+ * feature codes and, normally, the spatial order. Reading it back is a header
+ * check plus one copy per column, with no parsing.
+ *
+ * Layout (native byte order, every section starts on a COLUMN_ALIGN boundary):
+ *
+ *   Header
+ *   dictionary   featureCount x { uint32 length, name bytes }, in code order
+ *   x            count x double
+ *   y            count x double
+ *   type         count x FeatureType
+ *   origId       count x int32
+ */
+
+#pragma once
+#include "types.h"
+#include <cstdint>
+
+namespace cbin {
+
+constexpr char MAGIC[8] = { 'C', 'L', 'Q', 'C', 'B', 'I', 'N', '\0' };
+constexpr std::uint32_t VERSION = 1;
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304u;   ///< Reads differently on a foreign-endian machine
+constexpr std::uint64_t COLUMN_ALIGN = 64;
+
+/** @brief Header flag bits */
+enum : std::uint32_t {
+    FLAG_SPATIALLY_ORDERED = 1u << 0,   ///< Rows are in InstanceStore::sortSpatially() order
+    FLAG_FEATURE_MAJOR = 1u << 1,       ///< Rows are grouped by feature code (InstanceStore::featureMajor)
+};
+
+/**
+ * @brief Fixed-size file header; all offsets are from the start of the file
+ */
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint32_t flags;
+    std::uint32_t featureCount;
+    std::uint64_t count;            ///< Number of instances
+
+    double minX, minY, maxX, maxY;  ///< Bounding box of all instances (zero when empty)
+
+    std::uint64_t dictOffset;
+    std::uint64_t dictBytes;
+    std::uint64_t xOffset;
+    std::uint64_t yOffset;
+    std::uint64_t typeOffset;
+    std::uint64_t origIdOffset;
+};
+
+static_assert(sizeof(int) == sizeof(std::int32_t), "origId column is stored as int32");
+
+/** @brief Round `offset` up to the next section boundary */
+constexpr std::uint64_t alignUp(std::uint64_t offset) {
+    return (offset + COLUMN_ALIGN - 1) / COLUMN_ALIGN * COLUMN_ALIGN;
+}
+
+} // namespace cbin
@@ -1,67 +1,97 @@
-/**
- * @file config.h
- * @brief Configuration management for the clique-based colocation mining application
- *
- * This file defines the configuration structure and loader for runtime parameters.
- */
-
-#pragma once
-#include <iostream>
-#include <fstream>
-#include <string>
-#include <sstream>
-
- /**
-  * @brief Configuration structure for application settings
-  *
-  * Contains all runtime parameters for the clique-based colocation mining algorithm,
-  * including I/O paths, algorithm thresholds, and system settings.
-  */
-struct AppConfig {
-    // I/O Settings
-    std::string datasetPath;    ///< Path to input CSV dataset file
-    std::string outputPath;     ///< Path to output results file
-
-    // Algorithm Parameters
-    double neighborDistance;    ///< Distance threshold for spatial neighbors
-    double minPrev;            ///< Minimum prevalence threshold (0.0 to 1.0)
-    double minCondProb;        ///< Minimum conditional probability for rules (0.0 to 1.0)
-
-    // System Settings
-    bool debugMode;            ///< Enable debug output messages
-
-    /**
-     * @brief Constructor with default values
-     *
-     * Initializes configuration with sensible defaults that can be overridden
-     * by loading from a configuration file.
-     */
-    AppConfig()
-        : datasetPath("data/sample_data.csv"),
-        outputPath("src/c++/output/rules.txt"),
-        neighborDistance(5.0),
-        minPrev(0.6),
-        minCondProb(0.5),
-        debugMode(false) {
-    }
-};
-
-
-/**
- * @brief ConfigLoader class for loading application configuration from a file
- *
- * Provides static methods to parse configuration files in key=value format.
- */
-class ConfigLoader {
-public:
-    /**
-     * @brief Load configuration from a file
-     *
-     * Parses a configuration file with key=value pairs. Lines starting with '#'
-     * are treated as comments. If the file cannot be opened, default values are used.
-     *
-     * @param configPath Path to the configuration file
-     * @return AppConfig Configuration object with loaded or default values
-     */
-    static AppConfig load(const std::string& configPath);
+/**
+ * @file config.h
+ * @brief Configuration management for the clique-based colocation mining application
+ *
+ * This file defines the configuration structure and loader for runtime parameters.
+ */
+
+#pragma once
+#include "types.h"
+#include <iostream>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <sstream>
+#include <vector>
+
+ /**
+  * @brief Configuration structure for application settings
+  *
+  * Contains all runtime parameters for the clique-based colocation mining algorithm,
+  * including I/O paths, algorithm thresholds, and system settings.
+  */
+struct AppConfig {
+    // I/O Settings
+    std::string datasetPath;    ///< Input dataset: CSV or .cbin file, directory, or wildcard pattern
+    std::string outputPath;     ///< Path to output results file
+    std::string loaderMode;     ///< Dataset loader: "csv" (csv::CSVReader) or "mmap" (memory-mapped parser)
+    std::string snapshotPath;   ///< If set, a CSV dataset is also saved here as a .cbin snapshot
+    bool streamToGrid;          ///< Bin instances into the neighbor grid while loading (DataLoader::load_gridded)
+    std::string spatialIndex;   ///< Neighbor search structure: "grid", "kdtree" or "rtree" (see spatial_index.h)
+    std::string materializeMode; ///< Neighbor graph build: "buffered" or "two_pass" (see MaterializeMode)
+    size_t memoryBudgetMB;      ///< Most the neighbor graph build may allocate, in MB (0 = no limit)
+    std::string coordinatePrecision; ///< Grid distance tests: "double" or "float" (see CoordinatePrecision)
+    std::string neighborCacheDir; ///< If set, neighbor graphs are cached here by dataset hash and distance
+    std::string tileDir;        ///< If set, materialize and run IDS tile by tile with files here (see TiledNeighborhood)
+    size_t tilePoints;          ///< Most core instances per tile
+
+    // Load Filters (applied while reading the dataset)
+    std::vector<FeatureName> featureFilter;   ///< Feature types to keep (empty = all)
+    std::optional<BoundingBox> bbox;          ///< Region to keep (unset = everything)
+
+    // Algorithm Parameters
+    double neighborDistance;    ///< Distance threshold for spatial neighbors
+    std::vector<double> neighborDistances; ///< Sweep: run steps 2-4 once per distance (empty = neighborDistance only)
+    double minPrev;            ///< Minimum prevalence threshold (0.0 to 1.0)
+    double minCondProb;        ///< Minimum conditional probability for rules (0.0 to 1.0)
+
+    // System Settings
+    unsigned numThreads;       ///< Worker threads (0 = one per hardware thread)
+    bool debugMode;            ///< Enable debug output messages
+
+    /**
+     * @brief Constructor with default values
+     *
+     * Initializes configuration with sensible defaults that can be overridden
+     * by loading from a configuration file.
+     */
+    AppConfig()
+        : datasetPath("data/sample_data.csv"),
+        outputPath("src/c++/output/rules.txt"),
+        loaderMode("csv"),
+        snapshotPath(""),
+        streamToGrid(false),
+        spatialIndex("grid"),
+        materializeMode("buffered"),
+        memoryBudgetMB(0),
+        coordinatePrecision("double"),
+        neighborCacheDir(""),
+        tileDir(""),
+        tilePoints(1000000),
+        neighborDistance(5.0),
+        minPrev(0.6),
+        minCondProb(0.5),
+        numThreads(0),
+        debugMode(false) {
+    }
+};
+
+
+/**
+ * @brief ConfigLoader class for loading application configuration from a file
+ *
+ * Provides static methods to parse configuration files in key=value format.
+ */
+class ConfigLoader {
+public:
+    /**
+     * @brief Load configuration from a file
+     *
+     * Parses a configuration file with key=value pairs. Lines starting with '#'
+     * are treated as comments. If the file cannot be opened, default values are used.
+     *
+     * @param configPath Path to the configuration file
+     * @return AppConfig Configuration object with loaded or default values
+     */
+    static AppConfig load(const std::string& configPath);
 };
\ No newline at end of file
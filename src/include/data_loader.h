@@ -1,33 +1,189 @@
-/**
- * @file data_loader.h
- * @brief CSV data loading functionality for spatial instances
- */
-
-#pragma once
-#include "types.h"
-#include "csv.hpp"
-#include <string>
-#include <vector>
-
- /**
-  * @brief DataLoader class for loading spatial instances from CSV files
-  *
-  * Provides static methods to parse CSV datasets containing spatial feature instances.
-  */
-class DataLoader {
-public:
-    /**
-     * @brief Load spatial instances from a CSV file
-     *
-     * Expects CSV with columns: Feature, Instance, LocX, LocY
-     * - Feature: Feature type (e.g., "A", "B", "Restaurant")
-     * - Instance: Instance number (integer)
-     * - LocX: X coordinate (double)
-     * - LocY: Y coordinate (double)
-     *
-     * @param filepath Path to the CSV file
-     * @return std::vector<SpatialInstance> Vector of loaded spatial instances
-     * @note Instance IDs are generated as: FeatureType + InstanceNumber (e.g., "A1", "B2")
-     */
-    static std::vector<SpatialInstance> load_csv(const std::string& filepath);
-};
\ No newline at end of file
+/**
+ * @file data_loader.h
+ * @brief CSV data loading functionality for spatial instances
+ */
+
+#pragma once
+#include "types.h"
+#include "instance_store.h"
+#include "spatial_grid.h"
+#include "csv.hpp"
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Options controlling how a dataset is read
+ */
+struct LoadOptions {
+    std::string loader = "csv";   ///< CSV parser: "csv" (csv::CSVReader, load_csv) or "mmap" (load_mapped); ignored for .cbin files
+    unsigned threads = 0;         ///< Parser threads for the mmap loader (0 = one per hardware thread)
+
+    // Row filters, applied while reading: rejected rows never reach the store
+    // and their feature names are not added to the dictionary.
+    std::vector<FeatureName> features;   ///< Keep only these feature types (empty = all)
+    std::optional<BoundingBox> bbox;     ///< Keep only instances inside this box
+
+    bool keepsFeature(std::string_view name) const {
+        return features.empty() || std::find(features.begin(), features.end(), name) != features.end();
+    }
+    bool keepsPoint(double x, double y) const { return !bbox || bbox->contains(x, y); }
+    bool filters() const { return !features.empty() || bbox.has_value(); }
+};
+
+/**
+ * @brief A loaded dataset together with its grid (see DataLoader::load_gridded)
+ */
+struct GriddedDataset {
+    InstanceStore instances;
+    SpatialGrid grid;   ///< Cells hold final InstanceIds of `instances`
+};
+
+ /**
+  * @brief DataLoader class for loading spatial instances from CSV files
+  *
+  * Provides static methods to parse CSV datasets containing spatial feature instances.
+  */
+class DataLoader {
+public:
+    /**
+     * @brief Load a dataset with the loader selected in `options`
+     *
+     * Paths ending in ".cbin" are loaded as snapshots (load_snapshot), whatever
+     * the loader option says. A directory or a wildcard file name
+     * (e.g. "data/district_*.csv") is loaded as a sharded dataset (load_files).
+     *
+     * @throws std::invalid_argument if the loader name is unknown
+     */
+    static InstanceStore load(const std::string& filepath, const LoadOptions& options);
+
+    /**
+     * @brief Load spatial instances from a CSV file
+     *
+     * Expects CSV with columns: Feature, Instance, LocX, LocY
+     * - Feature: Feature type (e.g., "A", "B", "Restaurant")
+     * - Instance: Instance number (integer)
+     * - LocX: X coordinate (double)
+     * - LocY: Y coordinate (double)
+     *
+     * Feature names are interned into the store's dictionary while reading; once
+     * the whole file is read the dictionary is finalized and every instance
+     * carries the final (name-ordered) FeatureType code. The rows are then
+     * grouped by feature and Hilbert-ordered inside each feature
+     * (InstanceStore::sortSpatially).
+     *
+     * @param filepath Path to the CSV file
+     * @param options Row filters (feature subset, bounding box)
+     * @return InstanceStore Column store of the loaded spatial instances
+     * @note Instance IDs are the positions in the returned store (after the
+     *       spatial reordering); the "A1"-style label is FeatureName +
+     *       InstanceNumber (InstanceStore::label)
+     */
+    static InstanceStore load_csv(const std::string& filepath, const LoadOptions& options = LoadOptions());
+
+    /**
+     * @brief Load spatial instances from a memory-mapped CSV file
+     *
+     * Same columns and result as load_csv(), but the file is mapped instead of
+     * streamed through csv::CSVReader: column positions are found once in the
+     * header, numbers are parsed with std::from_chars straight into the store's
+     * columns, and feature names stay string_views into the mapping until they
+     * are interned. No per-row strings are allocated.
+     *
+     * The coordinate columns may be named LocX/LocY or X/Y. Fields are split on
+     * ',' only, so quoted fields must not contain commas or line breaks.
+     *
+     * With more than one thread the data rows are cut at line breaks into chunks
+     * that are parsed concurrently, each into its own columns and dictionary.
+     * The chunks are then stitched together in file order, so the result is the
+     * same for every thread count.
+     *
+     * @param filepath Path to the CSV file
+     * @param options Parser threads and row filters
+     * @return InstanceStore Column store of the loaded spatial instances
+     * @throws std::runtime_error if the file cannot be mapped, a column is
+     *         missing, or a number cannot be parsed
+     */
+    static InstanceStore load_mapped(const std::string& filepath, const LoadOptions& options = LoadOptions());
+
+    /**
+     * @brief Write a loaded store as a binary columnar snapshot (see cbin_format.h)
+     *
+     * The columns are written as they are, including the spatial order if the
+     * store has it, so loading the snapshot skips parsing and sorting. A store
+     * that is only feature-major (after NeighborhoodMgr::update()) is flagged
+     * as such and also keeps its row order, so its ids stay valid.
+     *
+     * @throws std::runtime_error if the file cannot be written
+     */
+    static void save_snapshot(const InstanceStore& instances, const std::string& filepath);
+
+    /**
+     * @brief Load a snapshot written by save_snapshot()
+     *
+     * The file is mapped and its columns copied into the store. Without row
+     * filters the result is the same store that was saved; with filters, the
+     * kept rows stay in their stored (spatial) order.
+     *
+     * @throws std::runtime_error if the file is not a snapshot of this version
+     *         and byte order, or is truncated
+     */
+    static InstanceStore load_snapshot(const std::string& filepath, const LoadOptions& options = LoadOptions());
+
+    /**
+     * @brief Load a dataset and bin it into a grid for neighbor distance `distance`
+     *
+     * The grid is what NeighborhoodMgr::materialize() would build from the
+     * store (cells of side `distance`, see SpatialGrid), produced during loading
+     * instead of by separate passes afterwards:
+     * - snapshot in spatial or feature-major order, no filters: the cells are
+     *   counted while the coordinate columns are copied, on the bounding box
+     *   from the header;
+     * - otherwise: the bounding box is tracked as rows are parsed, and the
+     *   points are binned (counting sort) once their final ids are known
+     *   (after InstanceStore::sortSpatially()).
+     */
+    static GriddedDataset load_gridded(const std::string& filepath, const LoadOptions& options, double distance);
+
+    /**
+     * @brief Load several dataset files concurrently into one store
+     *
+     * Each file is read on its own worker (CSV with the selected loader, or a
+     * .cbin snapshot), then the parts are merged in the given order under one
+     * feature dictionary and laid out like a single-file load.
+     *
+     * Files number their instances independently, so the same feature may
+     * reuse numbers across files. When a file reuses a number of a feature
+     * that an earlier file took, all its numbers of that feature are shifted
+     * to continue after the highest number taken (A1..A10 in the first file,
+     * A1..A5 in the second become A1..A15), keeping every label unique. Files
+     * whose numbers are disjoint from the earlier ones keep them, even when
+     * the ranges interleave (A1, A3 and A2, A4).
+     *
+     * @throws std::invalid_argument if the loader name is unknown
+     */
+    static InstanceStore load_files(const std::vector<std::string>& filepaths, const LoadOptions& options);
+
+    /**
+     * @brief List the files a dataset path stands for
+     *
+     * - directory: its .csv and .cbin files; a .csv with a .cbin of the same
+     *   name next to it is left out, the snapshot stands for it
+     * - wildcards ('*', '?') in the file name: the matching files of that
+     *   directory, with the same preference for snapshots
+     * - otherwise: the path itself
+     *
+     * The list is sorted by name, which fixes the merge order.
+     *
+     * @throws std::runtime_error if a directory or pattern matches no file
+     */
+    static std::vector<std::string> expandDatasetPath(const std::string& filepath);
+
+    /** @brief Whether a dataset path is a directory or a wildcard pattern */
+    static bool isMultiFilePath(const std::string& filepath);
+
+    /** @brief Whether a dataset path names a snapshot (".cbin" extension) */
+    static bool isSnapshotPath(const std::string& filepath);
+};
@@ -0,0 +1,82 @@
+/**
+ * @file distance_kernel.h
+ * @brief Vectorized "within distance" test of one point against a block of points
+ *
+ * NeighborhoodMgr::materialize() compares each instance with the coordinate
+ * blocks of its own and forward cells (SpatialGrid::cellX/cellY). The kernel
+ * returns a bitmask of the points within the threshold, which the caller walks
+ * with lowestBit().
+ *
+ * Variants: AVX-512F (8 lanes), AVX2 (4 lanes) and a portable scalar loop. The
+ * best one the CPU supports is chosen once at run time, so the binary itself
+ * needs no -mavx flags. All variants evaluate dx * dx + dy * dy <= r2 with
+ * separate multiplies and adds (no FMA), giving bit-identical results.
+ *
+ * The float kernels (BlockFnF) do the same on float coordinates with twice
+ * the lanes per register, for NeighborhoodMgr's reduced-precision mode. They
+ * sort points into "surely within" and "too close to call"; the caller
+ * decides the second kind with the double kernel.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace distance_kernel {
+
+/// Points per call: one bit of the returned mask each
+constexpr size_t BLOCK = 64;
+
+/** @brief Instruction set of a kernel variant */
+enum class Isa { Scalar, Avx2, Avx512 };
+
+/**
+ * @brief Bit j is set iff (xs[j] - px)^2 + (ys[j] - py)^2 <= r2, for j < count <= BLOCK
+ */
+using BlockFn = std::uint64_t (*)(double px, double py, const double* xs, const double* ys, size_t count, double r2);
+
+/**
+ * @brief Float variant: bit j of the result is set iff the float distance
+ *        (xs[j] - px)^2 + (ys[j] - py)^2 <= sure; bit j of *uncertain is set
+ *        iff that distance is in (sure, maybe]
+ */
+using BlockFnF = std::uint64_t (*)(float px, float py, const float* xs, const float* ys, size_t count,
+                                   float sure, float maybe, std::uint64_t* uncertain);
+
+/** @brief Whether this CPU can run variant `isa` (Scalar always) */
+bool supported(Isa isa);
+
+/** @brief Best variant supported by this CPU (detected on first call) */
+Isa detect();
+
+/** @brief Kernel of a variant; `isa` must be supported */
+BlockFn get(Isa isa);
+
+/** @brief Kernel of detect() */
+inline BlockFn select() { return get(detect()); }
+
+/** @brief Float kernel of a variant; `isa` must be supported */
+BlockFnF getFloat(Isa isa);
+
+/** @brief Float kernel of detect() */
+inline BlockFnF selectFloat() { return getFloat(detect()); }
+
+/** @brief "scalar", "avx2" or "avx512" */
+const char* name(Isa isa);
+
+/** @brief Index of the lowest set bit; `mask` must not be 0 */
+inline unsigned lowestBit(std::uint64_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+} // namespace distance_kernel
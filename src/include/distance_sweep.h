@@ -0,0 +1,56 @@
+/**
+ * @file distance_sweep.h
+ * @brief Neighbor graphs for several distance thresholds from one materialization
+ */
+
+#pragma once
+#include "types.h"
+#include "instance_store.h"
+#include "neighbor_graph.h"
+#include "neighborhood_mgr.h"
+#include <vector>
+
+/**
+ * @brief The neighbor graph at the largest distance of a sweep, plus the
+ *        squared length of each edge, from which smaller thresholds are cut
+ *
+ * A pair within d is within every larger distance, so the graph at d is the
+ * graph at dmax with the longer edges removed. Rows stay sorted and SNs stay
+ * in front, so filtering keeps the NeighborGraph layout without sorting.
+ *
+ * Edge lengths are kept as float (4 bytes per row entry, next to the 4 of the
+ * id). An edge whose float length is within a 2^-20 relative margin of d^2
+ * (more than float rounding) is decided again by the double distance kernel
+ * on the coordinates, so graphAt(d) is exactly the graph materialize() builds
+ * at d.
+ *
+ * The instances must outlive the sweep and keep their order.
+ */
+class DistanceSweep {
+public:
+    /**
+     * @brief Materialize at `maxDistance` with `neighborMgr` and its settings
+     *        (index, mode, budget, cache), taking the graph out of it
+     * @throws std::invalid_argument if maxDistance is not positive
+     */
+    DistanceSweep(NeighborhoodMgr& neighborMgr, const InstanceStore& instances, double maxDistance,
+                  unsigned threads = 0);
+
+    /**
+     * @brief Neighbor graph at `distance` (a copy at maxDistance())
+     * @throws std::invalid_argument if distance is not in (0, maxDistance()]
+     */
+    NeighborGraph graphAt(double distance) const;
+
+    double maxDistance() const { return maxDist; }
+
+    /** @brief Bytes held: the graph at maxDistance() and the edge lengths */
+    size_t memoryBytes() const;
+
+private:
+    const InstanceStore& instances;
+    double maxDist;
+    unsigned threadCount;
+    NeighborGraph graph;              ///< Graph at maxDist
+    std::vector<float> edgeDistSq;    ///< Squared length of graph.neighbors[e]
+};
@@ -0,0 +1,74 @@
+/**
+ * @file feature_dictionary.h
+ * @brief Interned feature-type dictionary (feature name <-> dense integer code)
+ *
+ * Every stage of the pipeline works on FeatureType codes; names are only looked
+ * up again when results are printed or written.
+ */
+
+#pragma once
+#include "types.h"
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Dictionary mapping each feature name to a dense FeatureType code
+ *
+ * Names are interned while the dataset is being read and receive provisional
+ * codes in first-seen order. finalize() renumbers them so that codes follow the
+ * lexicographic order of the names, which is the feature order used for the
+ * BN/SN split: `a < b` on codes gives the same answer as on the names.
+ */
+class FeatureDictionary {
+public:
+    FeatureDictionary() = default;
+    FeatureDictionary(const FeatureDictionary& other);
+    FeatureDictionary& operator=(const FeatureDictionary& other);
+    FeatureDictionary(FeatureDictionary&&) = default;
+    FeatureDictionary& operator=(FeatureDictionary&&) = default;
+
+    /**
+     * @brief Return the code of a feature name, adding it if it is new
+     * @throws std::length_error if more features than FeatureType can hold are added
+     */
+    FeatureType intern(std::string_view name);
+
+    /**
+     * @brief Renumber the codes in lexicographic name order
+     *
+     * @return std::vector<FeatureType> Remap table: remap[oldCode] == newCode.
+     *         Callers must apply it to every code handed out by intern() so far.
+     */
+    std::vector<FeatureType> finalize();
+
+    /** @brief Check whether a feature name has been interned */
+    bool contains(std::string_view name) const;
+
+    /**
+     * @brief Look up the code of an existing feature name
+     * @throws std::out_of_range if the name is unknown
+     */
+    FeatureType code(std::string_view name) const;
+
+    /** @brief Name of a feature code (only needed when producing output) */
+    const std::string& name(FeatureType code) const { return names_[code]; }
+
+    /** @brief Readable instance label, e.g. label(code of "A", 17) == "A17" */
+    std::string label(FeatureType code, int instanceNo) const {
+        return names_[code] + std::to_string(instanceNo);
+    }
+
+    size_t size() const { return names_.size(); }
+    bool empty() const { return names_.empty(); }
+
+private:
+    void rebuildIndex();
+
+    // std::deque never relocates its elements on push_back, so the string_view
+    // keys of index_ stay valid while new names are interned.
+    std::deque<std::string> names_;
+    std::unordered_map<std::string_view, FeatureType> index_;
+};
@@ -9,12 +9,12 @@
 
 
 
-class IDSTree 
+class IDSTree {
 public:
     // Constructor nhận vào dữ liệu cần thiết:
     // - neighbors_mgr: Quản lý thông tin láng giềng (neighborhood list, BNs, SNs)
     // - instances: Tập hợp tất cả các instances (S)
-    IDSTree(const NeighborhoodMgr& neighbors_mgr, const std::vector<Instance>& instances);
+    IDSTree(const NeighborhoodMgr& neighbors_mgr, const InstanceStore& instances);
     
     ~IDSTree();
 
@@ -22,9 +22,19 @@ public:
     // Trả về danh sách các I-cliques tìm được (mỗi clique là một vector các InstanceId)
     std::vector<std::vector<InstanceId>> run();
 
+    // Như run() nhưng chỉ bắt đầu từ các head-node trong `heads` (tăng dần theo id),
+    // ví dụ các instance thuộc lõi của một tile (xem TiledNeighborhood)
+    std::vector<std::vector<InstanceId>> run(InstanceSpan heads);
+
 private:
     const NeighborhoodMgr& neighbors_mgr_;
-    const std::vector<Instance>& instances_;
+    const InstanceStore& instances_;
     IDSNode* root_;
 
+    void deleteTree(IDSNode* node);
+
+    // Bước 3-16 cho một head-node s, thêm các clique tìm được vào Cls
+    void search(InstanceId s, std::vector<std::vector<InstanceId>>& Cls);
+};
+
 #endif // IDS_TREE_H
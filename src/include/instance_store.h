@@ -0,0 +1,82 @@
+/**
+ * @file instance_store.h
+ * @brief Struct-of-arrays storage for the loaded spatial instances
+ *
+ * InstanceId i refers to position i of every column. Keeping coordinates,
+ * types and dataset numbers in separate contiguous arrays lets the grid and the
+ * pair-distance loop read only what they need.
+ */
+
+#pragma once
+#include "types.h"
+#include "feature_dictionary.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Column store for all spatial instances (the set S)
+ */
+struct InstanceStore {
+    std::vector<double> x;            ///< X coordinate of each instance
+    std::vector<double> y;            ///< Y coordinate of each instance
+    std::vector<FeatureType> type;    ///< Feature type code of each instance
+    std::vector<int> origId;          ///< Instance number from the dataset ("Instance" column)
+    FeatureDictionary features;       ///< Names behind the type codes
+    bool spatiallyOrdered = false;    ///< Rows are in sortSpatially() order (cleared by push_back)
+    /// Rows are grouped by feature code in increasing order, so comparing ids
+    /// compares features first. Set by sortSpatially() and kept by
+    /// NeighborhoodMgr::update(), which does not keep the Hilbert order
+    /// (cleared by push_back)
+    bool featureMajor = false;
+
+    /// Bounding box of all rows, kept up to date by push_back() so that later
+    /// stages do not need a pass of their own. Code that fills the columns
+    /// directly must set it too. BoundingBox::none() while empty.
+    BoundingBox bounds = BoundingBox::none();
+
+    size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+
+    void reserve(size_t n);
+
+    /** @brief Append one instance; its InstanceId is the previous size(). Extends bounds. */
+    void push_back(FeatureType t, int instanceNo, double px, double py);
+
+    /** @brief Row view of one instance (copies four scalars) */
+    SpatialInstance at(InstanceId id) const {
+        return { type[id], id, x[id], y[id], origId[id] };
+    }
+
+    /** @brief Readable label of an instance, e.g. "A17" (output only) */
+    std::string label(InstanceId id) const { return features.label(type[id], origId[id]); }
+
+    /**
+     * @brief Reorder all columns: grouped by feature type, Hilbert order inside each group
+     *
+     * Within one feature, points that are close in space end up close in memory,
+     * so the instances of one grid cell form a few short runs instead of being
+     * scattered. Keeping the feature-major layout means that comparing two
+     * InstanceIds compares their feature types first, which is the sibling order
+     * the I-tree relies on (BN lists sorted by id are sorted by feature).
+     *
+     * InstanceIds are positions, so every id handed out before this call becomes
+     * invalid. Ties keep their previous relative order (deterministic layout).
+     */
+    void sortSpatially();
+
+    /**
+     * @brief 64-bit hash of the columns that define the neighbor graph: the
+     *        number of rows and the type, x and y of each, in row order
+     *
+     * Labels (origId, feature names) are left out, so two stores that differ
+     * only there hash alike, as their graphs are alike. Used as the cache key
+     * of NeighborhoodMgr::setCacheDirectory(). Not cryptographic.
+     */
+    std::uint64_t contentHash() const;
+};
+
+/**
+ * @brief Position of cell (x, y) along a Hilbert curve covering a 2^order x 2^order grid (order <= 16)
+ */
+std::uint64_t hilbertIndex(unsigned order, std::uint32_t x, std::uint32_t y);
@@ -0,0 +1,42 @@
+/**
+ * @file mapped_file.h
+ * @brief Read-only memory mapping of a whole file
+ */
+
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief RAII read-only mapping of a file into memory
+ *
+ * The contents are accessed in place, without copying them into a buffer.
+ * An empty file is valid and yields an empty view.
+ */
+class MappedFile {
+public:
+    /**
+     * @brief Map the whole file read-only
+     * @throws std::runtime_error if the file cannot be opened or mapped
+     */
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
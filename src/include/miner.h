@@ -1,27 +1,42 @@
-﻿/**
- * @file miner.h
- * @brief Prevalent co-locations filtering (Algorithm 5)
- *
- * File này định nghĩa các cấu trúc và lớp để thực hiện thuật toán lọc
- * các colocation phổ biến, tuân thủ tuyệt đối tên hàm và thứ tự trong ảnh.
- */
-
-#pragma once
-
-#include "calculate_pi.h"
-#include "types.h"
-#include "candidate_generation.h" // Để sử dụng cấu trúc CHash
-#include <vector>
-#include <algorithm>
-
-class PrevalentColocationMiner {
-private:
-	double minPrev;
-	NeighborhoodMgr* neighborhoodMgr;
-	std::vector<std::vector<SpatialInstance>> GetAllSubsets(const PatternKey& candidate);
-public:
-	std::unordered_map<PatternKey, double>mineColocations(
-		CHashStructure& chash,
-		double minPrev
-	)
-}
\ No newline at end of file
+﻿/**
+ * @file miner.h
+ * @brief Prevalent co-locations filtering (Algorithm 5)
+ *
+ * File này định nghĩa các cấu trúc và lớp để thực hiện thuật toán lọc
+ * các colocation phổ biến, tuân thủ tuyệt đối tên hàm và thứ tự trong ảnh.
+ */
+
+#pragma once
+
+#include "calculate_pi.h"
+#include "types.h"
+#include "instance_store.h"
+#include "candidate_generation.h" // Để sử dụng cấu trúc CHash
+#include <map>
+#include <vector>
+#include <algorithm>
+
+class PrevalentColocationMiner {
+private:
+	std::vector<size_t> featureCount;   // Số instance của từng feature (mẫu số của participation ratio)
+
+	// Các tập con bỏ đi đúng một feature của candidate (bước tỉa Apriori)
+	std::vector<PatternKey> GetAllSubsets(const PatternKey& candidate);
+public:
+	explicit PrevalentColocationMiner(const InstanceStore& instances);
+
+	/**
+	 * @brief Mọi co-location phổ biến (từ 2 feature) cùng PI của chúng
+	 *
+	 * Duyệt theo mức như Apriori: mức 2 là các cặp feature cùng nằm trong một
+	 * khóa của C-Hash; mức k + 1 ghép hai mẫu phổ biến mức k có chung k - 1
+	 * feature đầu và chỉ giữ ứng viên mà mọi tập con k feature đều phổ biến
+	 * (PI không tăng khi thêm feature). PI của ứng viên do CalculatePI tính.
+	 * Số ứng viên vì vậy bị chặn theo số mẫu phổ biến, không theo 2^k tập con
+	 * của từng khóa: khóa nhiều feature không bị bỏ qua hay làm bùng nổ.
+	 */
+	std::map<PatternKey, double> mineColocations(
+		const CHashStructure& chash,
+		double minPrev
+	);
+};
\ No newline at end of file
@@ -0,0 +1,86 @@
+/**
+ * @file neighbor_graph.h
+ * @brief Materialized neighborhood in compressed sparse row (CSR) form
+ */
+
+#pragma once
+#include "types.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Neighbor lists of all instances in three flat arrays
+ *
+ * Row `id` is neighbors[offsets[id], offsets[id + 1]), sorted by id. Because
+ * InstanceIds are feature-major (see InstanceStore::sortSpatially), a row
+ * sorted by id lists all SNs (smaller feature) before all BNs (bigger
+ * feature); snCount[id] marks the split. Neighbors of the same feature are not
+ * stored.
+ *
+ * The whole graph is three allocations regardless of the instance count, and
+ * the rows of consecutive ids are adjacent in memory.
+ */
+struct NeighborGraph {
+    std::vector<std::uint64_t> offsets;   ///< size() + 1 row starts; offsets[0] == 0
+    std::vector<std::uint32_t> snCount;   ///< Number of SNs at the front of each row
+    std::vector<InstanceId> neighbors;    ///< All rows back to back
+
+    /** @brief Number of rows (instances) */
+    size_t size() const { return snCount.size(); }
+
+    /** @brief Number of stored (directed) neighbor entries */
+    size_t edgeCount() const { return neighbors.size(); }
+
+    /** @brief SNs followed by BNs of an instance */
+    InstanceSpan neighborsOf(InstanceId id) const {
+        return InstanceSpan(neighbors.data() + offsets[id], static_cast<size_t>(offsets[id + 1] - offsets[id]));
+    }
+
+    /** @brief Neighbors with a smaller feature type, ascending id */
+    InstanceSpan smallNeighbors(InstanceId id) const {
+        return InstanceSpan(neighbors.data() + offsets[id], snCount[id]);
+    }
+
+    /** @brief Neighbors with a bigger feature type, ascending id */
+    InstanceSpan bigNeighbors(InstanceId id) const {
+        const std::uint64_t first = offsets[id] + snCount[id];
+        return InstanceSpan(neighbors.data() + first, static_cast<size_t>(offsets[id + 1] - first));
+    }
+
+    /** @brief Heap bytes of a graph with `rows` rows and `entries` neighbor entries, allocated exactly */
+    static size_t memoryBytesFor(size_t rows, size_t entries) {
+        return (rows + 1) * sizeof(std::uint64_t) + rows * sizeof(std::uint32_t) + entries * sizeof(InstanceId);
+    }
+
+    /** @brief Heap bytes held by the three arrays */
+    size_t memoryBytes() const {
+        return offsets.capacity() * sizeof(std::uint64_t) + snCount.capacity() * sizeof(std::uint32_t) +
+               neighbors.capacity() * sizeof(InstanceId);
+    }
+
+    void clear() {
+        offsets.assign(1, 0);
+        snCount.clear();
+        neighbors.clear();
+    }
+
+    /**
+     * @brief Write the three arrays to `path` (spill to disk)
+     *
+     * Layout, native byte order, each array starting on a cbin::COLUMN_ALIGN
+     * boundary: a header (magic "CLQCSR", version, byte-order mark, row and
+     * entry counts, array offsets), then offsets, snCount and neighbors as
+     * stored. Written next to the target and renamed, like snapshots.
+     *
+     * @throws std::runtime_error if the file cannot be written
+     */
+    void save(const std::string& path) const;
+
+    /**
+     * @brief Read a graph written by save()
+     * @throws std::runtime_error if the file is not a graph of this version
+     *         and byte order, or is truncated or inconsistent
+     */
+    static NeighborGraph load(const std::string& path);
+};
@@ -1,61 +1,284 @@
-﻿#pragma once
-#include "types.h"
-#include <vector>
-#include <unordered_map>
-#include <cmath>
-
-class NeighborhoodMgr {
-private:
-	std::unordered_map<const SpatialInstance*, NeighborList> allNeighbors;  // Bản đồ tất cả hàng xóm
-
-	size_t gridCellsX;  // Số ô lưới theo chiều X
-	size_t gridCellsY;  // Số ô lưới theo chiều Y
-
-    /**
-     * @brief Bước 1: DivideSpace(min_dist, S)
-     * Chia không gian thành các ô lưới dựa trên ngưỡng khoảng cách.
-     * * @param instances Tập dữ liệu đầu vào (S)
-     * @return GridMap Cấu trúc grids chứa các instance đã được phân chia
-     */
-    std::vector<Grid> divideSpace(double distanceThreshold, const std::vector<SpatialInstance>& instances);
-
-    /**
-     * @brief Bước 3: GetNeighborGrids(g)
-     * Lấy danh sách các ô lưới lân cận của ô hiện tại (bao gồm cả chính nó).
-     * * @param currentGridKey Key của ô lưới hiện tại (g)
-     * @return std::vector<std::string> Danh sách Key của các ô lân cận (ngrids)
-     */
-    std::vector<Grid*> getNeighborGrids(Grid&g, std::vector<Grid>& all_grids) const;
-
-    /**
-     * @brief Bước 6: Is_Neighbor(s, s', min_distance)
-     * Kiểm tra khoảng cách Euclide giữa 2 điểm.
-     * * @param s Instance 1
-     * @param s_prime Instance 2
-     * @return true Nếu khoảng cách <= distanceThreshold
-     */
-    bool isNeighbor(const SpatialInstance* s, const SpatialInstance* s_prime, double distanceThreshold) const;
-public:
-    /**
-     * @brief Thực thi thuật toán Neighborhood Materialization
-     * * Hàm này sẽ ghép nối logic giống hệt mã giả:
-     * 1. grids = divideSpace(...)
-     * 2. For each grid in grids...
-     * 3.   ngrids = getNeighborGrids(...)
-     * 4.   For each s in grid...
-     * 5.     For each s' in ngrids...
-     * 6.       If isNeighbor(...) -> Add to BNs/SNs
-     * * @param instances Danh sách tất cả các instance đầu vào (S)
-     */
-    void materialize(const std::vector<SpatialInstance>& instances, const double& distanceThreshold);
-
-    /**
-     * @brief Lấy toàn bộ map hàng xóm
-     */
-    const std::unordered_map<const SpatialInstance*, NeighborList>& getAllNeighbors() const;
-
-    void printResults() const;
-
-    // Helper for IDSTree
-    std::vector<InstanceId> getBigNeighbors(const InstanceId& id) const;
+﻿#pragma once
+#include "types.h"
+#include "instance_store.h"
+#include "spatial_grid.h"
+#include "spatial_index.h"
+#include "neighbor_graph.h"
+#include "feature_dictionary.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cmath>
+
+/** @brief Cách materialize() cấp phát đồ thị láng giềng */
+enum class MaterializeMode {
+    Buffered,   ///< Ghép một lần vào danh sách cạnh của từng dải, rồi đếm và rải (nhanh nhất)
+    TwoPass     ///< Ghép lần 1 chỉ đếm bậc, cấp phát đúng kích thước, ghép lần 2 ghi thẳng vào đồ thị
+};
+
+/** @brief Kiểu tọa độ mà phép ghép trên lưới dùng để so khoảng cách */
+enum class CoordinatePrecision {
+    Double,     ///< So thẳng trên tọa độ double (SpatialGrid::cellX/cellY)
+    Float       ///< Độ lệch float32 so với gốc ô, kiểm tra lại bằng double khi sát ngưỡng
+};
+
+/** @brief Kết quả của NeighborhoodMgr::update(): id mới và các hàng đã đổi */
+struct NeighborUpdate {
+    std::vector<InstanceId> remap;      ///< Id cũ -> id mới, INVALID_INSTANCE nếu đã xóa
+    std::vector<InstanceId> inserted;   ///< Id mới của từng instance thêm vào, theo thứ tự của `added`
+    std::vector<InstanceId> changed;    ///< Id mới (tăng dần) của mọi instance có danh sách láng giềng đổi, kể cả instance mới
+};
+
+class NeighborhoodMgr {
+private:
+	NeighborGraph graph;  // Hàng xóm của mọi instance (CSR), hàng thứ id là SNs rồi BNs của id
+	unsigned threadCount = 0;  // Số luồng cho materialize() (0 = theo số luồng phần cứng)
+	SpatialIndexKind indexKind = SpatialIndexKind::Grid;  // Cấu trúc tìm láng giềng (xem setSpatialIndex())
+	MaterializeMode mode = MaterializeMode::Buffered;  // Xem setMaterializeMode()
+	size_t memoryBudget = 0;  // Giới hạn byte khi dựng đồ thị (0 = không giới hạn), xem setMemoryBudget()
+	CoordinatePrecision precision = CoordinatePrecision::Double;  // Xem setCoordinatePrecision()
+	std::string cacheDirectory;  // Thư mục cache đồ thị (rỗng = tắt), xem setCacheDirectory()
+	bool cacheHit = false;  // Lần materialize() gần nhất đọc đồ thị từ cache
+
+    /**
+     * @brief Bước 1: DivideSpace(min_dist, S)
+     * Chia không gian thành các ô lưới dựa trên ngưỡng khoảng cách.
+     * * @param instances Tập dữ liệu đầu vào (S), đọc trực tiếp các cột x[]/y[] và instances.bounds
+     * @return SpatialGrid Lưới chứa các instance đã được phân chia
+     */
+    SpatialGrid divideSpace(double distanceThreshold, const InstanceStore& instances);
+
+    /**
+     * @brief Bước 3: GetNeighborGrids(g), dạng nửa stencil
+     * Lấy các ô lân cận "phía trước" ô hiện tại theo SpatialGrid::forwardStencil():
+     * với refinement 1 là (+1,0), (-1,+1), (0,+1), (+1,+1); với lưới mịn hơn
+     * stencil rộng k ô, bỏ các ô góc nằm hoàn toàn ngoài ngưỡng khoảng cách.
+     * Mỗi cặp ô chỉ được duyệt một lần (từ ô đứng trước theo thứ tự hàng).
+     * Bản thân ô g không nằm trong danh sách; các cặp trong g được duyệt riêng.
+     * Chỉ trả về các ô có instance (với lưới thưa, ô trống không được lưu).
+     * * @param cellId Chỉ số ô hiện tại trong lưới (xem SpatialGrid::cell())
+     * @param stencil grid.forwardStencil()
+     * @param neighbor_cells Nhận ô tương ứng với từng phần tử của stencil
+     *        (ngrids), SpatialGrid::NO_CELL nếu ô nằm ngoài lưới hoặc trống
+     */
+    void getForwardNeighborCells(size_t cellId, const SpatialGrid& grid, const std::vector<CellOffset>& stencil,
+                                 std::vector<size_t>& neighbor_cells) const;
+
+    /**
+     * @brief Bước 2-6 trên lưới: ghép từng ô với chính nó và các ô phía trước
+     *
+     * Gọi visit(band, s, s') đúng một lần cho mỗi cặp láng giềng khác feature,
+     * s có feature nhỏ hơn; `band` < bandCount là dải đang chạy.
+     */
+    template <typename Visit>
+    void joinGrid(const SpatialGrid& grid, const InstanceStore& instances, double distanceThreshold,
+                  unsigned threads, size_t bandCount, Visit visit) const;
+
+    /**
+     * @brief Bước 2-6 trên một SpatialIndex bất kỳ: mỗi instance s truy vấn
+     * bán kính distanceThreshold và giữ các s' có id lớn hơn (mỗi cặp một lần)
+     */
+    template <typename Visit>
+    void joinIndex(const SpatialIndex& index, const InstanceStore& instances, double distanceThreshold,
+                   unsigned threads, size_t bandCount, Visit visit) const;
+
+    /**
+     * @brief Dựng đồ thị CSR từ một phép ghép theo `mode`, rồi sắp xếp từng hàng theo id
+     *
+     * join(visit) chạy một phép ghép ở trên với visitor cho trước; ở chế độ
+     * TwoPass (và mọi khi có memoryBudget) nó được gọi hai lần. joinBytes là
+     * bộ nhớ mà mỗi lần ghép tự cấp phát, tính vào ngân sách.
+     * @throws std::length_error nếu vượt memoryBudget (trước khi cấp phát đồ thị)
+     */
+    template <typename Join>
+    void buildGraph(size_t n, unsigned threads, size_t bandCount, size_t joinBytes, Join join);
+
+    /** @brief Thân của materialize(instances, grid, d), không qua cache */
+    void materializeOnGrid(const InstanceStore& instances, const SpatialGrid& grid, double distanceThreshold);
+
+    /** @brief Thân của materialize(instances, index, d), không qua cache */
+    void materializeOnIndex(const InstanceStore& instances, const SpatialIndex& index, double distanceThreshold);
+
+    /**
+     * @brief File cache của (instances, d), rỗng nếu cache tắt
+     *
+     * Tên file gồm InstanceStore::contentHash() và bit của d (so khớp chính xác).
+     */
+    std::string cacheFile(const InstanceStore& instances, double distanceThreshold) const;
+
+    /** @brief Nạp đồ thị từ `path` nếu có và khớp số instance; đặt cacheHit */
+    bool loadCached(const std::string& path, size_t instanceCount);
+public:
+    /**
+     * @brief Thực thi thuật toán Neighborhood Materialization
+     * * Hàm này sẽ ghép nối logic giống hệt mã giả:
+     * 1. grids = divideSpace(...)
+     * 2. For each grid in grids...
+     * 3.   ngrids = getForwardNeighborCells(...)  (nửa stencil)
+     * 4.   For each cặp (s, s') trong grid, và giữa grid với ngrids...
+     * 5.     If Is_Neighbor(...) -> s' là BN của s và s là SN của s' (hoặc ngược lại)
+     * Bước 6 (Is_Neighbor) so một instance với cả khối tọa độ của một ô
+     * (SpatialGrid::cellX/cellY) bằng distance_kernel: AVX-512/AVX2 nếu CPU
+     * hỗ trợ, nếu không thì vòng lặp vô hướng; kết quả là mặt nạ bit.
+     * Mỗi cặp chỉ được tính khoảng cách một lần; các cạnh được gom lại rồi rải
+     * (counting scatter) vào đồ thị CSR, sau đó mỗi hàng được sắp xếp theo id.
+     *
+     * Chạy song song theo các dải ô lưới liên tiếp (xem setThreadCount()): mỗi dải
+     * ghi danh sách cạnh riêng, việc đếm và rải dùng bộ đếm atomic (không khóa).
+     * Vì mỗi hàng được sắp xếp ở cuối, kết quả giống hệt nhau với mọi số luồng.
+     * * @param instances Tất cả các instance đầu vào (S), InstanceId là vị trí trong store
+     * @throws std::invalid_argument nếu `instances` không feature-major
+     *         (InstanceStore::featureMajor): SN và BN của một hàng được tách
+     *         bằng thứ tự id, nên id phải nhóm theo feature như sau sortSpatially()
+     */
+    void materialize(const InstanceStore& instances, const double& distanceThreshold);
+
+    /**
+     * @brief Materialize trên lưới đã dựng sẵn (bỏ qua DivideSpace)
+     *
+     * Dùng với DataLoader::load_gridded(), lưới được chia ngay khi nạp dữ liệu.
+     * @throws std::invalid_argument nếu grid.reach nhỏ hơn ngưỡng khoảng cách
+     *         (khi đó stencil không còn chứa hết hàng xóm), hoặc nếu
+     *         `instances` không feature-major
+     */
+    void materialize(const InstanceStore& instances, const SpatialGrid& grid, const double& distanceThreshold);
+
+    /**
+     * @brief Materialize trên một chỉ mục không gian đã dựng sẵn
+     *
+     * Với GridIndex là đúng đường ghép ô ở trên; với KdTree/RTree mỗi instance
+     * truy vấn bán kính một lần. Mọi backend cho cùng một đồ thị.
+     * @throws std::invalid_argument nếu là GridIndex có grid.reach nhỏ hơn ngưỡng,
+     *         hoặc nếu `instances` không feature-major
+     */
+    void materialize(const InstanceStore& instances, const SpatialIndex& index, const double& distanceThreshold);
+
+    /**
+     * @brief Lấy toàn bộ danh sách hàng xóm (chỉ số là InstanceId)
+     *
+     * View chỉ đọc vào đồ thị CSR đã lưu (không copy); hết hiệu lực khi
+     * materialize() chạy lại.
+     */
+    const NeighborGraph& getAllNeighbors() const;
+
+    /**
+     * @brief Thay đồ thị đang giữ bằng `neighbors` (ví dụ NeighborGraph::load()
+     * của một tile đã spill ra đĩa), để IDSTree chạy trên đó
+     */
+    void setGraph(NeighborGraph neighbors);
+
+    /**
+     * @brief Thêm và xóa một loạt instance, vá đồ thị thay vì materialize lại
+     *
+     * Đồ thị hiện tại phải là đồ thị của `instances` ở `distanceThreshold`.
+     * InstanceId là vị trí trong store theo thứ tự feature-major, nên store
+     * được đánh số lại: các instance còn lại giữ thứ tự cũ, instance mới đứng
+     * cuối nhóm feature của nó. Tên feature mới được intern rồi finalize() như
+     * khi load, nên mã feature vẫn theo thứ tự tên và các nhóm xếp theo mã
+     * mới. Khi mã cũ đã theo thứ tự tên (store từ DataLoader), việc đánh số
+     * lại là phép ánh xạ tăng dần, nên các hàng không bị ảnh hưởng chỉ được
+     * đổi id, vẫn đúng thứ tự, không sắp xếp lại; nếu không, mỗi hàng được
+     * sắp lại. Store trả về có featureMajor nhưng không còn spatiallyOrdered.
+     *
+     * Phép so khoảng cách chỉ chạy quanh instance mới: một lưới thưa (ô rộng
+     * hơn d một chút) được dựng trên riêng các instance mới, mỗi instance dò
+     * 3x3 ô quanh nó (một bitmap các ô lân cận loại ngay phần lớn instance ở
+     * xa), cùng kernel với materialize(), nên kết quả giống hệt materialize()
+     * lại từ đầu trên store mới. Hàng của instance bị xóa cho biết các hàng
+     * cần bỏ cạnh, không cần tính khoảng cách.
+     *
+     * Chi phí mỗi lần gọi là O(N + E) dù lô nhỏ (N instance, E cạnh): mọi
+     * instance còn lại đều thử bitmap ô lân cận, và store cùng toàn bộ CSR
+     * được ghi lại theo id mới. Đây là lựa chọn có chủ ý: id phải là vị trí
+     * liền nhau theo thứ tự feature-major (IDS và C-Hash so id như so
+     * feature), nên chừa chỗ trống theo từng feature để chỉ đánh số lại cục
+     * bộ sẽ kéo theo id rỗng ở mọi bước sau. Chỉ phần so khoảng cách là tỉ lệ
+     * với lô. Trên 2 triệu instance đều, d = 10, một luồng: materialize()
+     * mất khoảng 630 ms, update() khoảng 125 ms với lô 10 hoặc 1000 instance,
+     * 470 ms với lô 100000; nên gom thay đổi thành lô lớn thay vì gọi cho
+     * từng instance.
+     *
+     * @param instances Store đã materialize, được ghi lại theo id mới
+     * @param removed Id (cũ) cần xóa, có thể trùng, thứ tự bất kỳ
+     * @param added Instance cần thêm (tên feature theo added.features)
+     * @return Ánh xạ id và các hàng đã đổi, để các bước sau (IDS, C-Hash)
+     *         chỉ tính lại quanh đó
+     * @throws std::invalid_argument nếu `instances` không feature-major (InstanceStore::featureMajor)
+     * @throws std::logic_error nếu đồ thị không khớp kích thước `instances`
+     * @throws std::out_of_range nếu một id trong `removed` không tồn tại
+     * @throws std::length_error nếu vượt memoryBudget hoặc quá 2^32 - 1 instance
+     */
+    NeighborUpdate update(InstanceStore& instances, const std::vector<InstanceId>& removed,
+                          const InstanceStore& added, double distanceThreshold);
+
+    /** @brief Chuyển đồ thị đang giữ ra ngoài (không copy), để lại đồ thị rỗng */
+    NeighborGraph takeGraph();
+
+    /** @brief Số luồng dùng cho materialize() (0 = theo số luồng phần cứng) */
+    void setThreadCount(unsigned threads);
+
+    /** @brief Chỉ mục mà materialize(instances, distance) dựng để tìm láng giềng (mặc định Grid) */
+    void setSpatialIndex(SpatialIndexKind kind);
+
+    /**
+     * @brief Buffered (mặc định) hoặc TwoPass
+     *
+     * Buffered giữ mọi cạnh trong danh sách tạm (8 byte mỗi cạnh, cộng phần dư
+     * khi vector tăng) cùng lúc với đồ thị. TwoPass tính khoảng cách hai lần
+     * nhưng bộ nhớ đỉnh chỉ là đồ thị, và biết trước kích thước khi cấp phát.
+     * Có setMemoryBudget() thì luôn chạy như TwoPass.
+     */
+    void setMaterializeMode(MaterializeMode materializeMode);
+
+    /**
+     * @brief Số byte tối đa materialize() được cấp phát, 0 = không giới hạn
+     *
+     * Gồm đồ thị láng giềng (NeighborGraph::memoryBytes) cùng bộ đếm bậc và
+     * độ lệch float của phép ghép khi ghi đồ thị, hoặc bộ đệm radix khi sắp
+     * hàng; không gồm dữ liệu, lưới hay chỉ mục không gian có sẵn.
+     * materialize() kiểm tra ngay khi biết bậc của mọi instance, trước khi cấp
+     * phát đồ thị, và ném std::length_error nếu vượt. Khi có ngân sách, đồ thị
+     * luôn dựng theo TwoPass: Buffered giữ mọi cạnh trước khi biết kích thước.
+     */
+    void setMemoryBudget(size_t bytes);
+
+    /**
+     * @brief Double (mặc định) hoặc Float cho phép ghép trên lưới
+     *
+     * Với Float, mỗi instance được so bằng độ lệch float32 so với gốc ô của
+     * nó: gấp đôi số làn SIMD và số tọa độ mỗi dòng cache. Cặp nào có bình
+     * phương khoảng cách float nằm trong một khoảng nhỏ quanh ngưỡng (sai số
+     * float bị chặn theo grid.reach) được tính lại đúng như kernel double, nên
+     * đồ thị giống hệt chế độ Double. Nếu tọa độ quá lớn so với kích thước ô
+     * để độ lệch còn chính xác, phép ghép tự dùng double. KdTree/RTree luôn
+     * dùng double.
+     */
+    void setCoordinatePrecision(CoordinatePrecision coordinatePrecision);
+
+    /**
+     * @brief Thư mục cache đồ thị láng giềng giữa các lần chạy (rỗng = tắt, mặc định)
+     *
+     * Đồ thị chỉ phụ thuộc dữ liệu và ngưỡng khoảng cách (mọi chỉ mục, chế độ
+     * và độ chính xác cho cùng kết quả), nên được lưu theo khóa
+     * InstanceStore::contentHash() + d. Mọi overload materialize() tìm file
+     * trong thư mục trước: nếu có, file được map vào bộ nhớ (NeighborGraph::load)
+     * và bỏ qua hoàn toàn Algorithm 1 (không dựng lưới hay chỉ mục); nếu không,
+     * đồ thị vừa tính được ghi vào đó (NeighborGraph::save, thư mục được tạo
+     * nếu thiếu). File hỏng hoặc khác phiên bản được tính lại và ghi đè.
+     * @throws std::runtime_error từ materialize() nếu không ghi được file cache
+     */
+    void setCacheDirectory(std::string directory);
+
+    /** @brief true nếu lần materialize() gần nhất lấy đồ thị từ cache */
+    bool loadedFromCache() const { return cacheHit; }
+
+    void printResults(const InstanceStore& instances) const;
+
+    /**
+     * @brief Helper for IDSTree: BNs của một instance, tra cứu O(1) theo id
+     *
+     * Trả về view trỏ thẳng vào danh sách đã lưu (không cấp phát, không copy),
+     * đã sắp xếp tăng dần theo id. View hết hiệu lực khi materialize() chạy lại.
+     */
+    InstanceSpan getBigNeighbors(InstanceId id) const;
 };
\ No newline at end of file
@@ -0,0 +1,74 @@
+/**
+ * @file parallel.h
+ * @brief Minimal fork-join helper for data-parallel loops
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Number of worker threads to use for a requested count
+ *
+ * 0 means "one per hardware thread"; the result is always at least 1.
+ */
+inline unsigned resolveThreadCount(unsigned requested) {
+    if (requested != 0) return requested;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * @brief Run body(i) for every i in [0, count) on up to `threads` threads
+ *
+ * Tasks are handed out in index order from a shared counter, so uneven tasks
+ * balance themselves. With one thread (or one task) everything runs inline on
+ * the caller's thread.
+ *
+ * If tasks throw, the remaining tasks are still run and the exception of the
+ * lowest failing index is rethrown once all threads have joined, so the error
+ * reported does not depend on scheduling.
+ */
+template <typename Body>
+void parallelFor(size_t count, unsigned threads, Body&& body) {
+    const size_t workers = std::min<size_t>(resolveThreadCount(threads), count);
+    if (workers <= 1) {
+        // Same contract as the threaded path: run everything, then rethrow
+        // the error of the lowest failing index
+        std::exception_ptr first;
+        for (size_t i = 0; i < count; ++i) {
+            try {
+                body(i);
+            } catch (...) {
+                if (!first) first = std::current_exception();
+            }
+        }
+        if (first) std::rethrow_exception(first);
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    std::vector<std::exception_ptr> errors(count);
+    auto work = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            try {
+                body(i);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(workers - 1);
+    for (size_t t = 1; t < workers; ++t) pool.emplace_back(work);
+    work();
+    for (auto& thread : pool) thread.join();
+
+    for (auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
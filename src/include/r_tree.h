@@ -0,0 +1,49 @@
+/**
+ * @file r_tree.h
+ * @brief STR-packed R-tree backend of SpatialIndex
+ */
+
+#pragma once
+#include "spatial_index.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief R-tree built bottom-up with Sort-Tile-Recursive packing
+ *
+ * STR sorts the points by x, cuts them into about sqrt(n / LEAF_CAPACITY)
+ * vertical slices, sorts each slice by y and packs runs of LEAF_CAPACITY
+ * points into leaves. Each upper level packs the node centers of the level
+ * below the same way, NODE_CAPACITY children per node, until one root is
+ * left. Every node is full except the last of a slice, and the leaves are
+ * nearly square tiles, so queries touch few nodes.
+ *
+ * As in KdTree, the points are permuted so that each leaf covers a contiguous
+ * range of ids/xs/ys, and the children of a node are contiguous in `nodes`.
+ */
+class RTree : public SpatialIndex {
+public:
+    /// Points per leaf
+    static constexpr size_t LEAF_CAPACITY = 32;
+    /// Children per inner node
+    static constexpr size_t NODE_CAPACITY = 16;
+
+    explicit RTree(const InstanceStore& instances);
+
+    SpatialIndexKind kind() const override { return SpatialIndexKind::RTree; }
+    void query(double x, double y, double radius, std::vector<InstanceId>& out) const override;
+    size_t memoryBytes() const override;
+
+private:
+    struct Node {
+        BoundingBox box;         ///< Bounding box of the points below
+        std::uint32_t first;     ///< Leaf: points [first, last) of ids/xs/ys;
+        std::uint32_t last;      ///< inner node: children [first, last) of nodes
+    };
+
+    std::vector<Node> nodes;     ///< Level by level from the leaves up; the root is last
+    size_t leafCount = 0;        ///< nodes[0, leafCount) are the leaves
+    std::vector<InstanceId> ids; ///< Instance ids in leaf order
+    std::vector<double> xs;      ///< x of ids[i]
+    std::vector<double> ys;      ///< y of ids[i]
+};
@@ -0,0 +1,68 @@
+/**
+ * @file snapshot_rows.h
+ * @brief Row-by-row read access to a .cbin snapshot without loading it
+ */
+
+#pragma once
+#include "types.h"
+#include "cbin_format.h"
+#include "feature_dictionary.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A snapshot (cbin_format.h) mapped read-only, its rows read in place
+ *
+ * The header and dictionary are checked like DataLoader::load_snapshot() does,
+ * but no column is copied: each accessor reads one value from the mapping, so
+ * a pass over the rows keeps only the pages in use resident and the memory
+ * does not grow with the file. Used to cut a dataset into tiles without
+ * loading it (TiledNeighborhood::partition(const std::string&)).
+ */
+class SnapshotRows {
+public:
+    /**
+     * @throws std::runtime_error if the file is not a snapshot of this version
+     *         and byte order, or is truncated
+     */
+    explicit SnapshotRows(const std::string& filepath);
+
+    size_t size() const { return static_cast<size_t>(header.count); }
+    bool empty() const { return header.count == 0; }
+    const FeatureDictionary& features() const { return dictionary; }
+    BoundingBox bounds() const { return { header.minX, header.minY, header.maxX, header.maxY }; }
+
+    /**
+     * @brief Whether load_snapshot() keeps the stored rows as they are: row i
+     *        of the file is instance i of the loaded store (without filters)
+     *
+     * True for the snapshots save_snapshot() writes of a spatially ordered or
+     * feature-major store.
+     */
+    bool finalOrder() const { return ordered; }
+
+    double x(size_t i) const { return read<double>(header.xOffset, i); }
+    double y(size_t i) const { return read<double>(header.yOffset, i); }
+    int origId(size_t i) const { return read<std::int32_t>(header.origIdOffset, i); }
+
+    /** @throws std::runtime_error if the stored code is out of range */
+    FeatureType type(size_t i) const;
+
+private:
+    template <typename T>
+    T read(std::uint64_t offset, size_t i) const {
+        T value;
+        std::memcpy(&value, file.data() + offset + i * sizeof(T), sizeof(T));
+        return value;
+    }
+
+    std::string path;
+    MappedFile file;
+    cbin::Header header;
+    FeatureDictionary dictionary;
+    std::vector<FeatureType> remap;   ///< Stored code -> finalized code
+    bool ordered = false;
+};
@@ -0,0 +1,173 @@
+/**
+ * @file spatial_grid.h
+ * @brief Uniform grid over the dataset's bounding box (DivideSpace of Algorithm 1)
+ */
+
+#pragma once
+#include "types.h"
+#include "instance_store.h"
+#include <cstdint>
+#include <vector>
+
+/** @brief How SpatialGrid stores its cells */
+enum class GridLayout {
+    Auto,     ///< Dense unless most cells would be empty (see SpatialGrid::DENSE_CELLS_PER_INSTANCE)
+    Dense,    ///< Every cell of the extent, row-major
+    Sparse    ///< Occupied cells only, found through a hash table on cell coordinates
+};
+
+/** @brief Column and row of a cell */
+struct CellCoord {
+    std::uint64_t cx;
+    std::uint64_t cy;
+};
+
+/** @brief Step from one cell to another, in cells */
+struct CellOffset {
+    int dx;
+    int dy;
+};
+
+/**
+ * @brief Square cells of side cellSize covering a bounding box
+ *
+ * The grid serves one neighbor distance, `reach`, with cells of side
+ * reach / refinement. With refinement 1 every neighbor of an instance lies in
+ * its own cell or one of the 8 surrounding cells. A finer side (refinement k)
+ * makes the stencil reach k cells out and drop the corner cells that are
+ * entirely farther than reach (see forwardStencil()). Points on the maximum
+ * edge are clamped into the last row/column.
+ *
+ * build() uses refinement 1: the join's plane sweep along x already cuts
+ * about as many candidates as finer cells would, without their extra cell
+ * visits. bench/grid_bench.cpp measures k = 1..4 on clustered data, up to
+ * thousands of points per cell, and k = 1 is the fastest in every case.
+ *
+ * The stored cells are flat, like NeighborGraph: cell c holds
+ * cellInstances[cellStart[c], cellStart[c + 1]) ordered by x (ties by id), so
+ * that a join of two cells can sweep along x. The grid is filled by a
+ * counting sort (count per cell, prefix sum, place), so it costs
+ * O(N + stored cells) plus the small per-cell sorts, and a fixed number of
+ * allocations.
+ *
+ * cellX/cellY repeat the coordinates of cellInstances in the same order, so a
+ * cell's points can be compared as two contiguous blocks (distance_kernel.h).
+ *
+ * A dense grid stores all cellsX * cellsY cells and c is the row-major index.
+ * With a wide extent and a small cell size that product can reach billions
+ * (or overflow), so a sparse grid stores only the occupied cells, in the order
+ * they were first seen, and maps CellCoord -> c with an open-addressing table.
+ */
+struct SpatialGrid {
+    /// Auto picks Dense while cellsX * cellsY <= this many cells per instance
+    static constexpr double DENSE_CELLS_PER_INSTANCE = 4.0;
+    /// Returned by findCell() for a cell that is not stored
+    static constexpr size_t NO_CELL = static_cast<size_t>(-1);
+
+    double minX = 0.0;
+    double minY = 0.0;
+    double reach = 1.0;                       ///< Neighbor distance the stencil covers
+    unsigned refinement = 1;                  ///< Cells per `reach` along each axis
+    double cellSize = 1.0;                    ///< reach / refinement
+    std::uint64_t cellsX = 0;                 ///< Number of cells along X (at least 1 unless the grid is empty)
+    std::uint64_t cellsY = 0;                 ///< Number of cells along Y (at least 1 unless the grid is empty)
+    bool sparse = false;                      ///< Layout chosen for this grid (never Auto)
+    std::vector<std::uint32_t> cellStart;     ///< cellCount() + 1 entries
+    std::vector<InstanceId> cellInstances;    ///< Ids of all cells back to back
+    std::vector<double> cellX;                ///< x of cellInstances[i]
+    std::vector<double> cellY;                ///< y of cellInstances[i]
+
+    std::vector<CellCoord> cellCoords;        ///< Sparse only: coordinates of stored cell c
+    std::vector<std::uint32_t> slots;         ///< Sparse only: hash table of c + 1 (0 = free), power-of-two size
+
+    /** @brief Grid without cells (for an empty dataset) */
+    SpatialGrid() = default;
+
+    /**
+     * @brief Grid covering `bounds` with all cells empty
+     *
+     * `instanceCount` is only used to choose the layout under GridLayout::Auto.
+     * Fill the grid with countPoint() for every instance, then place().
+     * @throws std::invalid_argument if reach or refinement is not positive, or
+     *         the extent has more than 2^62 cells along an axis
+     */
+    SpatialGrid(const BoundingBox& bounds, double reach, size_t instanceCount,
+                GridLayout layout = GridLayout::Auto, unsigned refinement = 1);
+
+    /** @brief Grid over instances.bounds with every instance placed */
+    static SpatialGrid build(const InstanceStore& instances, double reach,
+                             GridLayout layout = GridLayout::Auto, unsigned refinement = 1);
+
+    /** @brief Number of stored cells (all cells if dense, occupied ones if sparse) */
+    size_t cellCount() const { return cellStart.empty() ? 0 : cellStart.size() - 1; }
+    bool empty() const { return cellsX == 0; }
+
+    /** @brief Ids in stored cell c, by ascending x */
+    InstanceSpan cell(size_t c) const {
+        return InstanceSpan(cellInstances.data() + cellStart[c], cellStart[c + 1] - cellStart[c]);
+    }
+
+    /** @brief Column and row of the cell containing (x, y) */
+    CellCoord coordOf(double x, double y) const {
+        std::uint64_t cx = static_cast<std::uint64_t>((x - minX) / cellSize);
+        std::uint64_t cy = static_cast<std::uint64_t>((y - minY) / cellSize);
+        if (cx >= cellsX) cx = cellsX - 1;
+        if (cy >= cellsY) cy = cellsY - 1;
+        return { cx, cy };
+    }
+
+    /** @brief Column and row of stored cell c */
+    CellCoord coordOf(size_t c) const {
+        if (sparse) return cellCoords[c];
+        return { c % cellsX, c / cellsX };
+    }
+
+    /** @brief Stored cell at (cx, cy) inside the extent, or NO_CELL (sparse, unoccupied) */
+    size_t findCell(CellCoord coord) const {
+        if (!sparse) return static_cast<size_t>(coord.cy * cellsX + coord.cx);
+        for (size_t i = slotOf(coord);; i = (i + 1) & (slots.size() - 1)) {
+            const std::uint32_t slot = slots[i];
+            if (slot == 0) return NO_CELL;
+            const CellCoord& stored = cellCoords[slot - 1];
+            if (stored.cx == coord.cx && stored.cy == coord.cy) return slot - 1;
+        }
+    }
+
+    /** @brief Stored cell containing (x, y) (NO_CELL if sparse and unoccupied) */
+    size_t cellOf(double x, double y) const { return findCell(coordOf(x, y)); }
+
+    /** @brief Counting pass: reserve a slot for a point at (x, y) */
+    void countPoint(double x, double y) {
+        if (!sparse) ++cellStart[cellOf(x, y) + 1];
+        else ++cellStart[addCell(coordOf(x, y)) + 1];
+    }
+
+    /**
+     * @brief Offsets of the cells "after" a cell (row-major) that can hold a
+     *        point within `reach` of a point in it
+     *
+     * Half of the stencil, so that each pair of cells is visited from one side
+     * only: (dx > 0, dy = 0) and (dy > 0). A cell (dx, dy) is kept when the gap
+     * between the two cells, (|dx| - 1, |dy| - 1) cells clamped at 0, is at
+     * most `refinement` cells long. Refinement 1 gives the 4 classic offsets.
+     */
+    std::vector<CellOffset> forwardStencil() const;
+
+    /**
+     * @brief Placing pass: put every instance of `instances` into its cell
+     *
+     * Each instance must have been counted exactly once with its coordinates.
+     */
+    void place(const InstanceStore& instances);
+
+private:
+    /** @brief First probe position of `coord` in slots */
+    size_t slotOf(CellCoord coord) const {
+        std::uint64_t h = (coord.cx * 0x9E3779B97F4A7C15ull) ^ coord.cy;
+        h *= 0xC2B2AE3D27D4EB4Full;
+        return static_cast<size_t>(h ^ (h >> 32)) & (slots.size() - 1);
+    }
+
+    /** @brief Sparse: stored cell at `coord`, created (empty) if new */
+    size_t addCell(CellCoord coord);
+};
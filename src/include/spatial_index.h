@@ -0,0 +1,110 @@
+/**
+ * @file spatial_index.h
+ * @brief Radius queries over the instances, behind one interface for the grid,
+ *        k-d tree and R-tree backends
+ *
+ * NeighborhoodMgr::materialize() asks an index for every pair of instances
+ * within the neighbor distance. Which structure answers fastest depends on the
+ * data: the uniform grid wins on evenly spread points, while the trees adapt to
+ * clustered data and to distances that leave most grid cells empty. The
+ * backend is chosen with the `spatial_index` config key (see AppConfig).
+ *
+ * Every backend decides "within distance" with the same arithmetic as
+ * distance_kernel ((x' - x)^2 + (y' - y)^2 <= r^2, no FMA), so all of them give
+ * the same neighbor graph.
+ */
+
+#pragma once
+#include "types.h"
+#include "instance_store.h"
+#include "spatial_grid.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+/** @brief Structure behind a SpatialIndex */
+enum class SpatialIndexKind {
+    Grid,     ///< SpatialGrid: uniform cells of side <= the neighbor distance
+    KdTree,   ///< Static k-d tree, bulk loaded by median splits
+    RTree     ///< R-tree packed bottom-up with Sort-Tile-Recursive (STR)
+};
+
+/**
+ * @brief "grid", "kdtree" or "rtree"
+ * @throws std::invalid_argument for any other name
+ */
+SpatialIndexKind parseSpatialIndexKind(const std::string& name);
+
+/** @brief Config name of a backend (inverse of parseSpatialIndexKind()) */
+const char* spatialIndexName(SpatialIndexKind kind);
+
+/**
+ * @brief Static index of the points of an InstanceStore
+ *
+ * Built once over all instances (ids are positions in the store) and read-only
+ * afterwards, so queries may run concurrently.
+ */
+class SpatialIndex {
+public:
+    virtual ~SpatialIndex() = default;
+
+    virtual SpatialIndexKind kind() const = 0;
+
+    /**
+     * @brief Append to `out` the id of every instance within `radius` of (x, y)
+     *
+     * Ids come in no particular order; an instance at (x, y) itself is
+     * included. `out` is not cleared.
+     */
+    virtual void query(double x, double y, double radius, std::vector<InstanceId>& out) const = 0;
+
+    /** @brief Heap bytes held by the index */
+    virtual size_t memoryBytes() const = 0;
+
+    /**
+     * @brief Index of the given kind over all of `instances`
+     *
+     * `reach` is the largest radius that will be queried; the grid sizes its
+     * cells from it, the trees ignore it.
+     */
+    static std::unique_ptr<SpatialIndex> build(SpatialIndexKind kind, const InstanceStore& instances, double reach);
+
+protected:
+    /**
+     * @brief Every point of `box` is farther than sqrt(r2) from (x, y)
+     *
+     * Rounding is monotonic, so a point the distance test would accept is never
+     * inside a box rejected here.
+     */
+    static bool boxBeyond(const BoundingBox& box, double x, double y, double r2);
+
+    /** @brief Every point of `box` passes the distance test against (x, y) */
+    static bool boxWithin(const BoundingBox& box, double x, double y, double r2);
+
+    /**
+     * @brief Append ids[j] for each j < count with (xs[j], ys[j]) within
+     *        sqrt(r2) of (x, y), testing distance_kernel::BLOCK points per call
+     */
+    static void appendWithin(double x, double y, const InstanceId* ids, const double* xs, const double* ys,
+                             size_t count, double r2, std::vector<InstanceId>& out);
+};
+
+/**
+ * @brief SpatialGrid as a SpatialIndex
+ *
+ * materialize() recognizes this backend and joins whole cells with each other
+ * (see NeighborhoodMgr); query() visits the cells overlapping the query box.
+ */
+class GridIndex : public SpatialIndex {
+public:
+    explicit GridIndex(SpatialGrid grid) : cells(std::move(grid)) {}
+
+    SpatialIndexKind kind() const override { return SpatialIndexKind::Grid; }
+    void query(double x, double y, double radius, std::vector<InstanceId>& out) const override;
+    size_t memoryBytes() const override;
+
+    const SpatialGrid& grid() const { return cells; }
+
+private:
+    SpatialGrid cells;
+};
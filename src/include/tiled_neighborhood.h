@@ -0,0 +1,171 @@
+/**
+ * @file tiled_neighborhood.h
+ * @brief Out-of-core neighborhood materialization and IDS over spatial tiles
+ */
+
+#pragma once
+#include "types.h"
+#include "instance_store.h"
+#include "neighborhood_mgr.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A dataset cut into spatial tiles on disk, materialized and searched
+ *        one tile at a time
+ *
+ * partition() bisects the bounding box at the median of its longer side until
+ * every tile owns at most `maxCorePoints` instances (its core). A tile file
+ * also holds every other instance within the neighbor distance d of the
+ * tile's rectangle (the halo, one d wide). An I-clique with head s lies within
+ * d of s, and so do all the rows IDS reads for it (restricted to the clique's
+ * candidates), so IDS started from the core instances of a tile finds exactly
+ * the cliques a run over the whole dataset finds for them.
+ *
+ * partition() can also read a snapshot (.cbin) in place instead of a loaded
+ * store. The splits then come from a stride sample of the rows (estimated
+ * core counts), the rows are streamed once into one spill file per sampled
+ * region, and each region is loaded on its own and bisected exactly as above.
+ * The peak is one region plus the sample, not the dataset.
+ *
+ * Files per tile under `directory`:
+ * - tile_<k>.cbin  core and halo instances as a snapshot (cbin_format.h), in
+ *                  global id order, so that local ids compare like global ones
+ * - tile_<k>.ids   global id (uint32) and core flag (uint8) of each instance
+ * - tile_<k>.csr   neighbor graph of the tile (NeighborGraph::save())
+ * - tile_<k>.cliques  cliques found from the tile's core (runIds(), removed
+ *                  when the merge is done)
+ *
+ * Only one tile's instances and graph are in memory at a time. When a tile's
+ * graph would exceed the memory budget of the NeighborhoodMgr, materialize()
+ * splits that tile again and retries, so the budget bounds the peak (use
+ * MaterializeMode::TwoPass, which checks the budget before building anything
+ * large).
+ */
+class TiledNeighborhood {
+public:
+    /** @brief One tile on disk */
+    struct Tile {
+        std::string path;            ///< File path without extension
+        BoundingBox rect;            ///< Rectangle of the core instances
+        size_t corePoints = 0;
+        size_t points = 0;           ///< Core and halo instances
+        bool materialized = false;   ///< tile_<k>.csr is written
+    };
+
+    /**
+     * @param directory Where the tile files go (created if missing)
+     * @param distance Neighbor distance, which is also the halo width
+     * @param maxCorePoints Most core instances per tile (at least 1)
+     */
+    TiledNeighborhood(std::string directory, double distance, size_t maxCorePoints);
+
+    /**
+     * @brief Write the tiles of `instances`, replacing any previous tiles
+     * @throws std::invalid_argument if `instances` is not feature-major
+     *         (InstanceStore::featureMajor, as after sortSpatially())
+     * @throws std::runtime_error if a file cannot be written
+     */
+    void partition(const InstanceStore& instances);
+
+    /**
+     * @brief Write the tiles of the snapshot at `snapshotPath` without loading it
+     *
+     * Same tiles contract as partition(const InstanceStore&) for the store
+     * DataLoader::load_snapshot() would give (no filters): global ids are row
+     * numbers of the file. The tile boundaries may differ, since the medians
+     * of the first splits come from a sample.
+     * @throws std::invalid_argument if the snapshot's rows are not in their
+     *         final order (SnapshotRows::finalOrder())
+     * @throws std::runtime_error if the snapshot cannot be read or a file
+     *         cannot be written
+     */
+    void partition(const std::string& snapshotPath);
+
+    /**
+     * @brief Materialize every tile with `neighborMgr` and spill each graph to disk
+     *
+     * Uses the settings of `neighborMgr` (threads, index, mode, budget). Its
+     * own graph is left empty.
+     * @throws std::length_error if a tile over budget cannot be split further
+     */
+    void materialize(NeighborhoodMgr& neighborMgr);
+
+    /**
+     * @brief Run IDS tile by tile over the spilled graphs, calling
+     *        emit(const std::vector<InstanceId>&) for every clique
+     *
+     * Cliques are in global ids and in the order IDSTree::run() over the whole
+     * dataset would give them. Each tile spills its cliques to a run file
+     * (HEAD_BATCH heads at a time in memory); the runs are then merged by
+     * head, which is unique to one tile, so memory holds one clique per tile
+     * rather than all of them. One file per tile is open during the merge.
+     * @throws std::logic_error if a tile is not materialized
+     * @throws std::runtime_error if a run file cannot be written or read
+     */
+    template <typename Emit>
+    void runIds(Emit&& emit) const {
+        CliqueRuns runs(spillIds());
+        std::vector<InstanceId> clique;
+        while (runs.next(clique)) emit(static_cast<const std::vector<InstanceId>&>(clique));
+    }
+
+    /** @brief runIds() collected into one vector (holds every clique in memory) */
+    std::vector<std::vector<InstanceId>> runIds() const;
+
+    const std::vector<Tile>& tiles() const { return tileList; }
+
+    /** @brief Delete all tile files (the directory itself is kept) */
+    void removeFiles();
+
+    /// Heads searched per IDSTree::run() call before their cliques are spilled
+    static constexpr size_t HEAD_BATCH = 4096;
+    /// Sampled rows per expected tile when partitioning a snapshot (at least SAMPLE_MIN)
+    static constexpr size_t SAMPLE_PER_TILE = 256;
+    static constexpr size_t SAMPLE_MIN = 65536;
+    /// Rows buffered over all spill files before they are appended to disk
+    static constexpr size_t SPILL_BUFFER = 1 << 18;
+
+private:
+    /** @brief k-way merge of clique run files by head; deletes the files when destroyed */
+    class CliqueRuns {
+    public:
+        explicit CliqueRuns(std::vector<std::string> paths);
+        ~CliqueRuns();
+        CliqueRuns(const CliqueRuns&) = delete;
+        CliqueRuns& operator=(const CliqueRuns&) = delete;
+
+        /** @brief Next clique in head order into `clique`; false once every run is exhausted */
+        bool next(std::vector<InstanceId>& clique);
+
+    private:
+        struct Run;
+        std::vector<std::unique_ptr<Run>> runs;
+        std::vector<size_t> heap;    ///< Runs with a pending clique, smallest head on top
+    };
+
+    /** @brief IDS over every tile's core, each tile's cliques (global ids) written to its run file */
+    std::vector<std::string> spillIds() const;
+
+    std::string directory;
+    double distance;
+    size_t maxCorePoints;
+    std::vector<Tile> tileList;
+    size_t nextTile = 0;             ///< Number for the next tile file name
+
+    /** @brief Instances of a part of `source` (sorted positions) and its core rectangle */
+    struct Part {
+        std::vector<std::uint32_t> core;
+        std::vector<std::uint32_t> halo;
+        BoundingBox rect;
+    };
+
+    /** @brief Split `part` until cores fit maxCore, appending the written tiles to `out` */
+    void bisect(const InstanceStore& source, const std::vector<InstanceId>& globalIds, Part part,
+                size_t maxCore, std::vector<Tile>& out);
+
+    /** @brief Write one part as the files of a new tile */
+    Tile writeTile(const InstanceStore& source, const std::vector<InstanceId>& globalIds, const Part& part);
+};
@@ -1,91 +1,141 @@
-/**
- * @file types.h
- * @brief Core data type definitions for spatial colocation pattern mining
- *
- * This file defines the fundamental data structures and type aliases used throughout
- * the joinless colocation mining algorithm implementation.
- */
-
-#pragma once
-#include <string>
-#include <unordered_map>
-#include <vector>
-
- // ============================================================================
- // Type Aliases
- // ============================================================================
-
-struct SpatialInstance; // Forward decl
-
- /** @brief Type alias for feature types (e.g., "Restaurant", "Hotel") */
-using FeatureType = std::string;
-
-/** @brief Type alias for instance identifiers (e.g., "A1", "B2") */
-using instanceID = std::string;
-using InstanceId = instanceID;
-using Instance = SpatialInstance;
-
-/** @brief Type alias for a colocation pattern (set of feature types) */
-using Colocation = std::vector<FeatureType>;
-
-/** @brief Type alias for a colocation instance (set of spatial instance pointers) */
-using ColocationInstance = std::vector<const struct SpatialInstance*>;
-
-/**
- * @brief Định nghĩa kiểu dữ liệu cho một Grid (Ô lưới)
- * Key: ID của ô lưới (ví dụ chuỗi "x_y")
- * Value: Danh sách các con trỏ tới SpatialInstance nằm trong ô đó
- */
-struct Grid {
-    int grid_id;
-	std::vector<const SpatialInstance*> instances;
-};
-
-// ============================================================================
-// Data Structures
-// ============================================================================
-
-/**
- * @brief Structure representing a spatial data instance
- *
- * Each spatial instance has a feature type, unique identifier, and 2D coordinates.
- */
-struct SpatialInstance {
-    FeatureType type;  ///< Feature type of this instance (e.g., "A", "B")
-    instanceID id;     ///< Unique identifier (e.g., "A1", "B2")
-    double x, y;       ///< 2D spatial coordinates
-};
-
-struct NeighborList {
-    // Sử dụng con trỏ để đồng nhất với ColocationInstance và tối ưu bộ nhớ
-    std::vector<const SpatialInstance*> BNs;
-    std::vector<const SpatialInstance*> SNs;
-
-    // Helper: Thêm vào danh sách Big Neighbors
-    void addBN(const SpatialInstance* inst) {
-        BNs.push_back(inst);
-    }
-
-    // Helper: Thêm vào danh sách Small Neighbors
-    void addSN(const SpatialInstance* inst) {
-        SNs.push_back(inst);
-    }
-
-    // Kiểm tra xem có hàng xóm nào không
-    bool isEmpty() const {
-        return BNs.empty() && SNs.empty();
-    }
-};
-
-// Struct đại diện cho một node trong cây I-tree
-// Theo Definition 5 trong paper: contains instance-name and node-link
-struct IDSNode {
-    InstanceId instance_id;     // instance-name
-    IDSNode* right_sibling;     // node-link: links to the right sibling node
-    IDSNode* first_child;       // Pointer to the first child (để duyệt xuống dưới)
-    IDSNode* parent;            // Pointer to parent (để hỗ trợ pruning/RemoveAncestors)
-
-    // Constructor
-    IDSNode(InstanceId id)
-        : instance_id(id), right_sibling(nullptr), first_child(nullptr), parent(nullptr) {}
-};
+/**
+ * @file types.h
+ * @brief Core data type definitions for spatial colocation pattern mining
+ *
+ * This file defines the fundamental data structures and type aliases used throughout
+ * the joinless colocation mining algorithm implementation.
+ */
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+ // ============================================================================
+ // Type Aliases
+ // ============================================================================
+
+struct SpatialInstance; // Forward decl
+
+ /**
+  * @brief Type alias for feature types
+  *
+  * Dense integer code assigned by FeatureDictionary. Codes follow the
+  * lexicographic order of the feature names, so they can be compared directly
+  * for the BN/SN split. Names are only looked up again at output time.
+  */
+using FeatureType = std::uint16_t;
+
+/** @brief Type alias for feature names (e.g., "Restaurant", "Hotel") */
+using FeatureName = std::string;
+
+/**
+ * @brief Type alias for instance identifiers
+ *
+ * Dense index of the instance in the loaded instance array. The readable
+ * label (e.g., "A1", "B2") is only produced when results are written, see
+ * FeatureDictionary::label().
+ */
+using InstanceId = std::uint32_t;
+using instanceID = InstanceId;
+using Instance = SpatialInstance;
+
+/** @brief Sentinel id for nodes that do not stand for an instance (e.g., the I-tree root) */
+constexpr InstanceId INVALID_INSTANCE = std::numeric_limits<InstanceId>::max();
+
+/**
+ * @brief Non-owning read-only view over a contiguous range (C++17 has no std::span)
+ *
+ * Used to hand out stored neighbor lists without copying them. The view is only
+ * valid while the owner of the storage is alive and unchanged.
+ */
+template <typename T>
+struct Span {
+    const T* first = nullptr;
+    std::size_t count = 0;
+
+    Span() = default;
+    Span(const T* ptr, std::size_t n) : first(ptr), count(n) {}
+    Span(const std::vector<T>& v) : first(v.data()), count(v.size()) {}
+
+    const T* begin() const { return first; }
+    const T* end() const { return first + count; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](std::size_t i) const { return first[i]; }
+};
+
+/** @brief View over a list of instance ids (e.g., the BNs of one instance) */
+using InstanceSpan = Span<InstanceId>;
+
+/** @brief Type alias for a colocation pattern (set of feature type codes) */
+using Colocation = std::vector<FeatureType>;
+
+/** @brief Type alias for a colocation instance (set of instance ids) */
+using ColocationInstance = std::vector<InstanceId>;
+
+// ============================================================================
+// Data Structures
+// ============================================================================
+
+/**
+ * @brief Axis-aligned rectangle in dataset coordinates (bounds inclusive)
+ */
+struct BoundingBox {
+    double minX, minY, maxX, maxY;
+
+    bool contains(double x, double y) const {
+        return x >= minX && x <= maxX && y >= minY && y <= maxY;
+    }
+
+    /** @brief Grow the box so that it contains (x, y) */
+    void include(double x, double y) {
+        minX = std::min(minX, x);
+        minY = std::min(minY, y);
+        maxX = std::max(maxX, x);
+        maxY = std::max(maxY, y);
+    }
+
+    /** @brief Grow the box so that it contains `other` */
+    void include(const BoundingBox& other) {
+        minX = std::min(minX, other.minX);
+        minY = std::min(minY, other.minY);
+        maxX = std::max(maxX, other.maxX);
+        maxY = std::max(maxY, other.maxY);
+    }
+
+    /** @brief Box containing nothing (min > max); include() grows it from the first point */
+    static BoundingBox none() {
+        const double inf = std::numeric_limits<double>::infinity();
+        return { inf, inf, -inf, -inf };
+    }
+};
+
+/**
+ * @brief Structure representing a spatial data instance
+ *
+ * Each spatial instance has a feature type, unique identifier, and 2D coordinates.
+ */
+struct SpatialInstance {
+    FeatureType type;  ///< Feature type code of this instance (see FeatureDictionary)
+    instanceID id;     ///< Dense index of this instance in the instance array
+    double x, y;       ///< 2D spatial coordinates
+    int instanceNo;    ///< Instance number from the dataset (label = feature name + instanceNo)
+};
+
+// Struct đại diện cho một node trong cây I-tree
+// Theo Definition 5 trong paper: contains instance-name and node-link
+struct IDSNode {
+    InstanceId instance_id;     // instance-name
+    IDSNode* right_sibling;     // node-link: links to the right sibling node
+    IDSNode* first_child;       // Pointer to the first child (để duyệt xuống dưới)
+    IDSNode* parent;            // Pointer to parent (để hỗ trợ pruning/RemoveAncestors)
+
+    // Constructor
+    IDSNode(InstanceId id)
+        : instance_id(id), right_sibling(nullptr), first_child(nullptr), parent(nullptr) {}
+};
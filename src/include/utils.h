@@ -4,25 +4,27 @@
 #include "types.h"
 #include <vector>
 #include "neighborhood_mgr.h"
+#include "feature_dictionary.h"
 
 
 /**
  * @brief Finds the intersection of two vectors of InstanceIds.
  * 
- * Note: This function handles sorting internally to ensure correctness,
- * as set_intersection requires sorted ranges.
+ * Note: Both inputs must be sorted in ascending id order. BN lists are sorted by
+ * NeighborhoodMgr::materialize() and I-tree siblings inherit that order, so the
+ * intersection is a single linear merge with no copies or sorting.
  * 
- * @param v1 First vector
- * @param v2 Second vector
- * @return std::vector<InstanceId> The intersection (elements present in both)
+ * @param v1 First vector (sorted)
+ * @param v2 Second vector (sorted)
+ * @return std::vector<InstanceId> The intersection (elements present in both), sorted
  */
-std::vector<InstanceId> getIntersection(const std::vector<InstanceId>& v1, const std::vector<InstanceId>& v2);
+std::vector<InstanceId> getIntersection(InstanceSpan v1, InstanceSpan v2);
 
 
 
 
-// Helper to print pattern
-void printPattern(const Colocation& pattern);
+// Helper to print pattern (codes are translated back to names here)
+void printPattern(const Colocation& pattern, const FeatureDictionary& features);
 
 // ==================================================================================
 // ALGORITHM 2 HELPERS
@@ -0,0 +1,24 @@
+#include "calculate_pi.h"
+
+// ==================================================================================
+// ALGORITHM 6: Calculate PI
+// ==================================================================================
+std::vector<std::vector<InstanceId>> CalculatePI::calculatePI(const CHashStructure& chash,
+                                                              const PatternKey& candidate) {
+    std::vector<std::vector<InstanceId>> columns(candidate.size());
+    for (const auto& entry : chash) {
+        // Khóa và candidate đều là tập feature tăng dần
+        const PatternKey& key = entry.first;
+        if (!std::includes(key.begin(), key.end(), candidate.begin(), candidate.end())) continue;
+        for (size_t i = 0; i < candidate.size(); ++i) {
+            const std::vector<InstanceId>& column = entry.second.feature_columns.at(candidate[i]);
+            columns[i].insert(columns[i].end(), column.begin(), column.end());
+        }
+    }
+    // Một instance có thể nằm trong nhiều clique
+    for (std::vector<InstanceId>& column : columns) {
+        std::sort(column.begin(), column.end());
+        column.erase(std::unique(column.begin(), column.end()), column.end());
+    }
+    return columns;
+}
@@ -0,0 +1,29 @@
+#include "candidate_generation.h"
+
+// ==================================================================================
+// ALGORITHM 4: Candidate generation
+// ==================================================================================
+PatternKey CandidateGenerator::GetFeatures(const std::vector<InstanceId>& clique, const InstanceStore& instances) {
+    // Id theo thứ tự feature-major nên feature của một clique (tăng dần theo id)
+    // cũng tăng dần; mỗi feature xuất hiện một lần trong một I-clique
+    PatternKey key;
+    key.reserve(clique.size());
+    for (InstanceId id : clique) key.push_back(instances.type[id]);
+    return key;
+}
+
+CHashStructure CandidateGenerator::Candidate_generation(const std::vector<std::vector<InstanceId>>& cls,
+                                                        const InstanceStore& instances) {
+    CHashStructure chash;
+    // Dòng 1-8: với mỗi clique cl, newKey = GetFeatures(cl), rồi thêm từng
+    // instance của cl vào cột feature của nó trong chash[newKey]
+    for (const std::vector<InstanceId>& cl : cls) AddClique(cl, instances, chash);
+    return chash;
+}
+
+void CandidateGenerator::AddClique(const std::vector<InstanceId>& cl, const InstanceStore& instances,
+                                   CHashStructure& chash) {
+    if (cl.size() < 2) return;   // Một instance đứng riêng không tạo thành mẫu
+    PatternInstanceTable& table = chash[GetFeatures(cl, instances)];
+    for (InstanceId instance : cl) table.AddInstance(instances.type[instance], instance);
+}
@@ -1,45 +1,109 @@
-/**
- * @file config.cpp
- * @brief Implementation of configuration file loading
- */
-
-#include "config.h"
-#include <iostream>
-#include <fstream>
-#include <sstream>
-
-
- // Load configuration from a file
-AppConfig ConfigLoader::load(const std::string& configPath) {
-    AppConfig config;  // Start with default values
-    std::ifstream file(configPath);
-
-    // If file cannot be opened, return default configuration
-    if (!file.is_open()) {
-        std::cerr << "Warning: Config file not found, using defaults.\n";
-        return config;
-    }
-
-    // Parse configuration file line by line
-    std::string line;
-    while (std::getline(file, line)) {
-        // Skip comments and empty lines
-        if (line.empty() || line[0] == '#') continue;
-
-        // Parse key=value pairs
-        std::istringstream is_line(line);
-        std::string key;
-        if (std::getline(is_line, key, '=')) {
-            std::string value;
-            if (std::getline(is_line, value)) {
-                // Map configuration keys to struct members
-                if (key == "dataset_path") config.datasetPath = value;
-                else if (key == "neighbor_distance") config.neighborDistance = std::stod(value);
-                else if (key == "min_prevalence") config.minPrev = std::stod(value);
-                else if (key == "min_cond_prob") config.minCondProb = std::stod(value);
-                else if (key == "debug_mode") config.debugMode = (value == "true" || value == "1");
-            }
-        }
-    }
-    return config;
+/**
+ * @file config.cpp
+ * @brief Implementation of configuration file loading
+ */
+
+#include "config.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Blanks and the '\r' of CRLF files around a key, value or list item
+std::string trim(const std::string& text) {
+    const size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos) return std::string();
+    const size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+// Split a comma-separated value, trimming blanks and dropping empty items
+std::vector<std::string> splitList(const std::string& value) {
+    std::vector<std::string> items;
+    std::istringstream is(value);
+    std::string item;
+    while (std::getline(is, item, ',')) {
+        item = trim(item);
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// "minX,minY,maxX,maxY"
+BoundingBox parseBoundingBox(const std::string& value) {
+    std::vector<std::string> parts = splitList(value);
+    if (parts.size() != 4) {
+        throw std::invalid_argument("Config: bbox expects minX,minY,maxX,maxY, got '" + value + "'");
+    }
+    BoundingBox box{ std::stod(parts[0]), std::stod(parts[1]), std::stod(parts[2]), std::stod(parts[3]) };
+    if (box.minX > box.maxX || box.minY > box.maxY) {
+        throw std::invalid_argument("Config: bbox minimum exceeds maximum in '" + value + "'");
+    }
+    return box;
+}
+
+} // namespace
+
+
+ // Load configuration from a file
+AppConfig ConfigLoader::load(const std::string& configPath) {
+    AppConfig config;  // Start with default values
+    std::ifstream file(configPath);
+
+    // If file cannot be opened, return default configuration
+    if (!file.is_open()) {
+        std::cerr << "Warning: Config file not found, using defaults.\n";
+        return config;
+    }
+
+    // Parse configuration file line by line
+    std::string line;
+    while (std::getline(file, line)) {
+        // Drop a trailing comment ("key=value   # note", as in the README),
+        // then skip comments and empty lines
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos && (comment == 0 || line[comment - 1] == ' ' || line[comment - 1] == '\t')) {
+            line.erase(comment);
+        }
+        line = trim(line);
+        if (line.empty()) continue;
+
+        // Parse key=value pairs (both trimmed, so CRLF files and blanks
+        // around '=' read the same as plain ones)
+        std::istringstream is_line(line);
+        std::string key;
+        if (std::getline(is_line, key, '=')) {
+            key = trim(key);
+            std::string value;
+            if (std::getline(is_line, value)) {
+                value = trim(value);
+                // Map configuration keys to struct members
+                if (key == "dataset_path") config.datasetPath = value;
+                else if (key == "loader") config.loaderMode = value;
+                else if (key == "snapshot_path") config.snapshotPath = value;
+                else if (key == "stream_to_grid") config.streamToGrid = (value == "true" || value == "1");
+                else if (key == "spatial_index") config.spatialIndex = value;
+                else if (key == "materialize_mode") config.materializeMode = value;
+                else if (key == "memory_budget_mb") config.memoryBudgetMB = static_cast<size_t>(std::stoull(value));
+                else if (key == "coordinate_precision") config.coordinatePrecision = value;
+                else if (key == "neighbor_cache_dir") config.neighborCacheDir = value;
+                else if (key == "tile_dir") config.tileDir = value;
+                else if (key == "tile_points") config.tilePoints = static_cast<size_t>(std::stoull(value));
+                else if (key == "feature_filter") config.featureFilter = splitList(value);
+                else if (key == "bbox") config.bbox = parseBoundingBox(value);
+                else if (key == "neighbor_distance") config.neighborDistance = std::stod(value);
+                else if (key == "neighbor_distances") {
+                    config.neighborDistances.clear();
+                    for (const std::string& item : splitList(value)) config.neighborDistances.push_back(std::stod(item));
+                }
+                else if (key == "min_prevalence") config.minPrev = std::stod(value);
+                else if (key == "min_cond_prob") config.minCondProb = std::stod(value);
+                else if (key == "threads") config.numThreads = static_cast<unsigned>(std::stoul(value));
+                else if (key == "debug_mode") config.debugMode = (value == "true" || value == "1");
+            }
+        }
+    }
+    return config;
 };
\ No newline at end of file
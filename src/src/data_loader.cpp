@@ -1,33 +1,473 @@
-/**
- * @file data_loader.cpp
- * @brief Implementation of CSV data loading for spatial instances
- */
-
-#include "data_loader.h"
-#include <iostream>
-
-using namespace csv;
-
-std::vector<SpatialInstance> DataLoader::load_csv(const std::string& filepath) {
-    CSVReader reader(filepath);
-    std::vector<SpatialInstance> instances;
-
-    // Parse each row from the CSV file
-    for (auto& row : reader) {
-        SpatialInstance instance;
-
-        // Map CSV columns to SpatialInstance fields
-        instance.type = row["Feature"].get<FeatureType>();
-
-        // Generate instance ID by concatenating feature type and instance number
-        // Example: Feature "A" with Instance 1 becomes "A1"
-        instance.id = instanceID(instance.type + std::to_string(row["Instance"].get<int>()));
-
-        instance.x = row["LocX"].get<double>();
-        instance.y = row["LocY"].get<double>();
-
-        instances.push_back(instance);
-    }
-
-    return instances;
-}
\ No newline at end of file
+/**
+ * @file data_loader.cpp
+ * @brief Implementation of CSV data loading for spatial instances
+ */
+
+#include "data_loader.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+using namespace csv;
+
+namespace {
+
+constexpr size_t NO_COLUMN = std::numeric_limits<size_t>::max();
+
+/**
+ * @brief Positions of the needed columns in a CSV header
+ */
+struct ColumnLayout {
+    size_t feature = NO_COLUMN;
+    size_t instance = NO_COLUMN;
+    size_t x = NO_COLUMN;
+    size_t y = NO_COLUMN;
+    size_t last = 0;    ///< Highest of the four positions; later fields are skipped
+};
+
+// Strip blanks, a trailing '\r' and surrounding quotes from one field
+std::string_view trimField(std::string_view field) {
+    while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) field.remove_prefix(1);
+    while (!field.empty() && (field.back() == ' ' || field.back() == '\t' || field.back() == '\r')) field.remove_suffix(1);
+    if (field.size() >= 2 && field.front() == '"' && field.back() == '"') {
+        field.remove_prefix(1);
+        field.remove_suffix(1);
+    }
+    return field;
+}
+
+ColumnLayout parseHeader(std::string_view header, const std::string& filepath) {
+    ColumnLayout layout;
+    size_t index = 0;
+    while (true) {
+        size_t comma = header.find(',');
+        std::string_view name = trimField(header.substr(0, comma));
+
+        if (name == "Feature") layout.feature = index;
+        else if (name == "Instance") layout.instance = index;
+        else if (name == "LocX" || name == "X") layout.x = index;
+        else if (name == "LocY" || name == "Y") layout.y = index;
+
+        if (comma == std::string_view::npos) break;
+        header.remove_prefix(comma + 1);
+        ++index;
+    }
+
+    if (layout.feature == NO_COLUMN || layout.instance == NO_COLUMN ||
+        layout.x == NO_COLUMN || layout.y == NO_COLUMN) {
+        throw std::runtime_error("DataLoader: '" + filepath +
+                                 "' needs Feature, Instance, LocX (or X) and LocY (or Y) columns");
+    }
+    layout.last = std::max(std::max(layout.feature, layout.instance), std::max(layout.x, layout.y));
+    return layout;
+}
+
+template <typename T>
+T parseNumber(std::string_view field, size_t lineNo, const char* column, const std::string& filepath) {
+    T value{};
+    const char* end = field.data() + field.size();
+    auto result = std::from_chars(field.data(), end, value);
+    if (result.ec != std::errc() || result.ptr != end) {
+        throw std::runtime_error("DataLoader: " + filepath + ":" + std::to_string(lineNo) +
+                                 ": invalid " + column + " value '" + std::string(field) + "'");
+    }
+    return value;
+}
+
+/**
+ * @brief Parse the data rows in [begin, end) and append the kept ones to `out`
+ *
+ * Feature names are interned into out.features with provisional codes, and only
+ * once a row of that feature passes the filters. Rows of unwanted features are
+ * dropped before their numbers are parsed.
+ * `firstLineNo` is the 1-based line number of `begin`, used in error messages.
+ */
+void parseRows(const char* begin, const char* end, const ColumnLayout& layout, const LoadOptions& filter,
+               InstanceStore& out, size_t firstLineNo, const std::string& filepath) {
+    // Rows are usually grouped by feature, so remember the verdict on the last name
+    std::string_view lastName;
+    bool haveLast = false;
+    bool lastKept = false;
+    bool lastInterned = false;
+    FeatureType lastType = 0;
+
+    const char* p = begin;
+    for (size_t lineNo = firstLineNo; p < end; ++lineNo) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (eol == nullptr) eol = end;
+        std::string_view line(p, static_cast<size_t>(eol - p));
+        p = eol + 1;
+
+        if (trimField(line).empty()) continue;
+
+        std::string_view featureField, instanceField, xField, yField;
+        size_t index = 0;
+        while (index <= layout.last) {
+            size_t comma = line.find(',');
+            std::string_view field = line.substr(0, comma);
+
+            if (index == layout.feature) featureField = trimField(field);
+            else if (index == layout.instance) instanceField = trimField(field);
+            else if (index == layout.x) xField = trimField(field);
+            else if (index == layout.y) yField = trimField(field);
+
+            if (comma == std::string_view::npos) break;
+            line.remove_prefix(comma + 1);
+            ++index;
+        }
+        if (index < layout.last) {
+            throw std::runtime_error("DataLoader: " + filepath + ":" + std::to_string(lineNo) +
+                                     ": expected at least " + std::to_string(layout.last + 1) + " fields");
+        }
+
+        if (!haveLast || featureField != lastName) {
+            lastName = featureField;
+            haveLast = true;
+            lastKept = filter.keepsFeature(featureField);
+            lastInterned = false;
+        }
+        if (!lastKept) continue;
+
+        const double px = parseNumber<double>(xField, lineNo, "LocX", filepath);
+        const double py = parseNumber<double>(yField, lineNo, "LocY", filepath);
+        if (!filter.keepsPoint(px, py)) continue;
+
+        if (!lastInterned) {
+            lastType = out.features.intern(featureField);
+            lastInterned = true;
+        }
+        out.push_back(lastType, parseNumber<int>(instanceField, lineNo, "Instance", filepath), px, py);
+    }
+}
+
+// Below this, a chunk is not worth a thread of its own
+constexpr size_t MIN_CHUNK_BYTES = size_t(1) << 20;
+
+/**
+ * @brief Cut [begin, end) into about `parts` pieces that each end after a '\n'
+ *
+ * Returns the piece boundaries: piece i is [bounds[i], bounds[i + 1]).
+ */
+std::vector<const char*> splitAtLines(const char* begin, const char* end, size_t parts) {
+    const size_t bytes = static_cast<size_t>(end - begin);
+    parts = std::max<size_t>(1, std::min(parts, bytes / MIN_CHUNK_BYTES));
+
+    std::vector<const char*> bounds{ begin };
+    for (size_t i = 1; i < parts; ++i) {
+        const char* cut = begin + bytes / parts * i;
+        if (cut <= bounds.back()) continue;
+        const char* eol = static_cast<const char*>(std::memchr(cut, '\n', static_cast<size_t>(end - cut)));
+        if (eol == nullptr) break;
+        bounds.push_back(eol + 1);
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+/**
+ * @brief Concatenate per-chunk stores into `out`, in chunk order
+ *
+ * Each chunk interned its feature names into its own dictionary. The names are
+ * interned into out.features chunk by chunk, which reproduces the first-seen
+ * order of a single-threaded parse, and every chunk's codes are translated
+ * while its columns are copied to their final offsets.
+ *
+ * If `idShifts` is given, (*idShifts)[c][code] is added to the instance numbers
+ * of chunk c's rows of that (chunk-local) feature code.
+ */
+void mergeChunks(std::vector<InstanceStore>& chunks, InstanceStore& out, unsigned threads,
+                 const std::vector<std::vector<int>>* idShifts = nullptr) {
+    std::vector<std::vector<FeatureType>> codeMaps(chunks.size());
+    std::vector<size_t> offsets(chunks.size() + 1, 0);
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        const FeatureDictionary& local = chunks[c].features;
+        for (FeatureType code = 0; code < local.size(); ++code) {
+            codeMaps[c].push_back(out.features.intern(local.name(code)));
+        }
+        offsets[c + 1] = offsets[c] + chunks[c].size();
+        out.bounds.include(chunks[c].bounds);
+    }
+
+    out.x.resize(offsets.back());
+    out.y.resize(offsets.back());
+    out.type.resize(offsets.back());
+    out.origId.resize(offsets.back());
+
+    parallelFor(chunks.size(), threads, [&](size_t c) {
+        InstanceStore& chunk = chunks[c];
+        const size_t at = offsets[c];
+        std::copy(chunk.x.begin(), chunk.x.end(), out.x.begin() + at);
+        std::copy(chunk.y.begin(), chunk.y.end(), out.y.begin() + at);
+        for (size_t i = 0; i < chunk.size(); ++i) {
+            out.type[at + i] = codeMaps[c][chunk.type[i]];
+        }
+        if (idShifts == nullptr) {
+            std::copy(chunk.origId.begin(), chunk.origId.end(), out.origId.begin() + at);
+        } else {
+            const std::vector<int>& shift = (*idShifts)[c];
+            for (size_t i = 0; i < chunk.size(); ++i) {
+                out.origId[at + i] = chunk.origId[i] + shift[chunk.type[i]];
+            }
+        }
+        chunk = InstanceStore();  // Release the chunk's memory as soon as it is copied
+    });
+}
+
+// Shared tail of every loader: final feature codes, then the spatial layout
+void finishLoad(InstanceStore& instances) {
+    // Codes handed out while reading are in first-seen order; renumber them so
+    // that they follow the name order used for BN/SN classification.
+    std::vector<FeatureType> remap = instances.features.finalize();
+    for (auto& type : instances.type) {
+        type = remap[type];
+    }
+
+    // Feature-major, Hilbert order within each feature: grid neighbors of the same
+    // feature become memory neighbors while id order still follows feature order
+    instances.sortSpatially();
+}
+
+// load_csv() without finishLoad(): provisional feature codes, file order
+InstanceStore readCsv(const std::string& filepath, const LoadOptions& options) {
+    CSVReader reader(filepath);
+    InstanceStore instances;
+
+    // Parse each row from the CSV file
+    for (auto& row : reader) {
+        // Map CSV columns to the store's columns.
+        // The feature name is interned once; the instance only keeps its code.
+        csv::string_view featureName = row["Feature"].get<csv::string_view>();
+        if (!options.keepsFeature(featureName)) continue;
+
+        double x = row["LocX"].get<double>();
+        double y = row["LocY"].get<double>();
+        if (!options.keepsPoint(x, y)) continue;
+
+        FeatureType type = instances.features.intern(featureName);
+
+        // The dataset's instance number is kept so that the "A1"-style label can
+        // be produced at output time; the internal ID is the position in the store
+        int instanceNo = row["Instance"].get<int>();
+
+        instances.push_back(type, instanceNo, x, y);
+    }
+    return instances;
+}
+
+// load_mapped() without finishLoad(): provisional feature codes, file order
+InstanceStore readMapped(const std::string& filepath, const LoadOptions& options) {
+    MappedFile file(filepath);
+    std::string_view text = file.view();
+    InstanceStore instances;
+
+    // Skip a UTF-8 byte order mark
+    if (text.size() >= 3 && text.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+        text.remove_prefix(3);
+    }
+
+    size_t headerEnd = text.find('\n');
+    ColumnLayout layout = parseHeader(text.substr(0, headerEnd), filepath);
+    if (headerEnd == std::string_view::npos) {
+        return instances;  // Header only
+    }
+    text.remove_prefix(headerEnd + 1);
+
+    const unsigned threads = resolveThreadCount(options.threads);
+    const std::vector<const char*> bounds =
+        splitAtLines(text.data(), text.data() + text.size(), threads > 1 ? 4 * size_t(threads) : 1);
+    const size_t chunkCount = bounds.size() - 1;
+
+    // Line breaks per chunk: sizes each chunk's columns (at most one row per
+    // line, only worth reserving when no filter drops rows) and gives the line
+    // number at which each chunk starts
+    std::vector<size_t> lineCounts(chunkCount);
+    parallelFor(chunkCount, threads, [&](size_t c) {
+        lineCounts[c] = static_cast<size_t>(std::count(bounds[c], bounds[c + 1], '\n'));
+    });
+
+    if (chunkCount == 1) {
+        if (!options.filters()) instances.reserve(lineCounts[0] + 1);
+        parseRows(bounds[0], bounds[1], layout, options, instances, 2, filepath);
+    } else {
+        std::vector<size_t> firstLine(chunkCount, 2);
+        for (size_t c = 1; c < chunkCount; ++c) {
+            firstLine[c] = firstLine[c - 1] + lineCounts[c - 1];
+        }
+
+        std::vector<InstanceStore> chunks(chunkCount);
+        parallelFor(chunkCount, threads, [&](size_t c) {
+            if (!options.filters()) chunks[c].reserve(lineCounts[c] + 1);
+            parseRows(bounds[c], bounds[c + 1], layout, options, chunks[c], firstLine[c], filepath);
+        });
+        mergeChunks(chunks, instances, threads);
+    }
+    return instances;
+}
+
+// Whether two sorted ranges have a value in common
+bool sharesValue(const std::vector<int>& a, const std::vector<int>& b) {
+    auto i = a.begin(), j = b.begin();
+    while (i != a.end() && j != b.end()) {
+        if (*i < *j) ++i;
+        else if (*j < *i) ++j;
+        else return true;
+    }
+    return false;
+}
+
+// Glob match of a whole file name: '*' = any run of characters, '?' = one character
+bool matchesWildcard(std::string_view name, std::string_view pattern) {
+    size_t n = 0, p = 0;
+    size_t starP = std::string_view::npos, starN = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+            ++n;
+            ++p;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            starP = p++;
+            starN = n;
+        } else if (starP != std::string_view::npos) {
+            p = starP + 1;
+            n = ++starN;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+} // namespace
+
+InstanceStore DataLoader::load(const std::string& filepath, const LoadOptions& options) {
+    if (isMultiFilePath(filepath)) return load_files(expandDatasetPath(filepath), options);
+    if (isSnapshotPath(filepath)) return load_snapshot(filepath, options);
+    if (options.loader == "csv") return load_csv(filepath, options);
+    if (options.loader == "mmap") return load_mapped(filepath, options);
+    throw std::invalid_argument("DataLoader: unknown loader '" + options.loader + "' (expected csv or mmap)");
+}
+
+InstanceStore DataLoader::load_csv(const std::string& filepath, const LoadOptions& options) {
+    InstanceStore instances = readCsv(filepath, options);
+    finishLoad(instances);
+    return instances;
+}
+
+InstanceStore DataLoader::load_mapped(const std::string& filepath, const LoadOptions& options) {
+    InstanceStore instances = readMapped(filepath, options);
+    finishLoad(instances);
+    return instances;
+}
+
+bool DataLoader::isMultiFilePath(const std::string& filepath) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (fs::is_directory(filepath, ec)) return true;
+    return fs::path(filepath).filename().string().find_first_of("*?") != std::string::npos;
+}
+
+std::vector<std::string> DataLoader::expandDatasetPath(const std::string& filepath) {
+    namespace fs = std::filesystem;
+    if (!isMultiFilePath(filepath)) return { filepath };
+
+    std::error_code ec;
+    const bool isDirectory = fs::is_directory(filepath, ec);
+    const fs::path dir = isDirectory ? fs::path(filepath) : fs::path(filepath).parent_path();
+    const std::string pattern = isDirectory ? std::string() : fs::path(filepath).filename().string();
+
+    std::vector<std::string> files;
+    for (const auto& entry : fs::directory_iterator(dir.empty() ? fs::path(".") : dir)) {
+        if (!entry.is_regular_file()) continue;
+        const std::string name = entry.path().filename().string();
+        if (isDirectory) {
+            const std::string ext = entry.path().extension().string();
+            if (ext != ".csv" && ext != ".cbin") continue;
+        } else if (!matchesWildcard(name, pattern)) {
+            continue;
+        }
+        files.push_back((dir / name).string());
+    }
+    if (files.empty()) {
+        throw std::runtime_error("DataLoader: no dataset files match '" + filepath + "'");
+    }
+    // Name order fixes the file order, so ids and numbering do not depend on the
+    // order the directory happens to list its entries in
+    std::sort(files.begin(), files.end());
+
+    // x.cbin next to x.csv is a snapshot of it: load the dataset once, from the snapshot
+    std::vector<std::string> kept;
+    for (const std::string& file : files) {
+        fs::path snapshot(file);
+        if (snapshot.extension() == ".csv" &&
+            std::binary_search(files.begin(), files.end(), snapshot.replace_extension(".cbin").string())) {
+            continue;
+        }
+        kept.push_back(file);
+    }
+    return kept;
+}
+
+InstanceStore DataLoader::load_files(const std::vector<std::string>& filepaths, const LoadOptions& options) {
+    if (options.loader != "csv" && options.loader != "mmap") {
+        throw std::invalid_argument("DataLoader: unknown loader '" + options.loader + "' (expected csv or mmap)");
+    }
+
+    // One worker per file; spare threads go to the mmap parser of each file
+    const unsigned threads = resolveThreadCount(options.threads);
+    LoadOptions fileOptions = options;
+    fileOptions.threads = std::max<unsigned>(1, threads / static_cast<unsigned>(std::max<size_t>(1, filepaths.size())));
+
+    std::vector<InstanceStore> parts(filepaths.size());
+    parallelFor(filepaths.size(), threads, [&](size_t f) {
+        const std::string& path = filepaths[f];
+        if (isSnapshotPath(path)) parts[f] = load_snapshot(path, fileOptions);
+        else if (options.loader == "csv") parts[f] = readCsv(path, fileOptions);
+        else parts[f] = readMapped(path, fileOptions);
+    });
+
+    // Every file numbers its instances on its own (A1, A2, ... in each file).
+    // Where a file reuses a number an earlier file already took for the same
+    // feature, all its numbers of that feature are shifted to start right
+    // after the highest number taken, so labels stay unique. Numbers that
+    // collide with none (below, between, above or interleaved with the earlier
+    // ones) are left unchanged.
+    std::vector<std::vector<int>> idShifts(parts.size());
+    std::unordered_map<std::string, std::vector<int>> taken;   // Sorted numbers per feature, after shifting
+    for (size_t f = 0; f < parts.size(); ++f) {
+        const InstanceStore& part = parts[f];
+        const size_t featureCount = part.features.size();
+        std::vector<std::vector<int>> numbers(featureCount);
+        for (size_t i = 0; i < part.size(); ++i) numbers[part.type[i]].push_back(part.origId[i]);
+
+        idShifts[f].assign(featureCount, 0);
+        for (FeatureType code = 0; code < featureCount; ++code) {
+            std::vector<int>& own = numbers[code];
+            if (own.empty()) continue;
+            std::sort(own.begin(), own.end());
+            own.erase(std::unique(own.begin(), own.end()), own.end());
+
+            std::vector<int>& used = taken[part.features.name(code)];
+            if (sharesValue(own, used)) {
+                idShifts[f][code] = used.back() + 1 - own.front();
+                for (int& number : own) number += idShifts[f][code];
+            }
+            const size_t middle = used.size();
+            used.insert(used.end(), own.begin(), own.end());
+            std::inplace_merge(used.begin(), used.begin() + static_cast<std::ptrdiff_t>(middle), used.end());
+        }
+    }
+
+    InstanceStore instances;
+    mergeChunks(parts, instances, threads, &idShifts);
+    finishLoad(instances);
+    return instances;
+}
@@ -0,0 +1,189 @@
+/**
+ * @file distance_kernel.cpp
+ * @brief Scalar, AVX2 and AVX-512 variants of the block distance test (double and float)
+ *
+ * The SIMD variants are compiled with per-function target attributes and only
+ * called after a CPU check. This file is built with -ffp-contract=off (see
+ * CMakeLists.txt) so that no variant is turned into FMA behind our back.
+ */
+
+#include "distance_kernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DISTANCE_KERNEL_X86 1
+#include <immintrin.h>
+#else
+#define DISTANCE_KERNEL_X86 0
+#endif
+
+namespace distance_kernel {
+
+namespace {
+
+std::uint64_t withinScalar(double px, double py, const double* xs, const double* ys, size_t count, double r2) {
+    std::uint64_t mask = 0;
+    for (size_t j = 0; j < count; ++j) {
+        const double dx = xs[j] - px;
+        const double dy = ys[j] - py;
+        const double distSq = dx * dx + dy * dy;
+        mask |= static_cast<std::uint64_t>(distSq <= r2) << j;
+    }
+    return mask;
+}
+
+std::uint64_t withinScalarF(float px, float py, const float* xs, const float* ys, size_t count,
+                            float sure, float maybe, std::uint64_t* uncertain) {
+    std::uint64_t mask = 0;
+    std::uint64_t close = 0;
+    for (size_t j = 0; j < count; ++j) {
+        const float dx = xs[j] - px;
+        const float dy = ys[j] - py;
+        const float distSq = dx * dx + dy * dy;
+        mask |= static_cast<std::uint64_t>(distSq <= sure) << j;
+        close |= static_cast<std::uint64_t>(distSq <= maybe) << j;
+    }
+    *uncertain = close & ~mask;
+    return mask;
+}
+
+#if DISTANCE_KERNEL_X86
+
+__attribute__((target("avx2")))
+std::uint64_t withinAvx2(double px, double py, const double* xs, const double* ys, size_t count, double r2) {
+    const __m256d vpx = _mm256_set1_pd(px);
+    const __m256d vpy = _mm256_set1_pd(py);
+    const __m256d vr2 = _mm256_set1_pd(r2);
+
+    std::uint64_t mask = 0;
+    size_t j = 0;
+    for (; j + 4 <= count; j += 4) {
+        const __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + j), vpx);
+        const __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys + j), vpy);
+        const __m256d distSq = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        const int lanes = _mm256_movemask_pd(_mm256_cmp_pd(distSq, vr2, _CMP_LE_OQ));
+        mask |= static_cast<std::uint64_t>(lanes) << j;
+    }
+    // Fewer than 4 left: a masked load is not worth it
+    if (j < count) mask |= withinScalar(px, py, xs + j, ys + j, count - j, r2) << j;
+    return mask;
+}
+
+__attribute__((target("avx512f")))
+std::uint64_t withinAvx512(double px, double py, const double* xs, const double* ys, size_t count, double r2) {
+    const __m512d vpx = _mm512_set1_pd(px);
+    const __m512d vpy = _mm512_set1_pd(py);
+    const __m512d vr2 = _mm512_set1_pd(r2);
+
+    std::uint64_t mask = 0;
+    for (size_t j = 0; j < count; j += 8) {
+        // The last step loads only the lanes that exist (masked loads do not fault)
+        const __mmask8 valid = count - j >= 8 ? static_cast<__mmask8>(0xFF)
+                                              : static_cast<__mmask8>((1u << (count - j)) - 1);
+        const __m512d dx = _mm512_sub_pd(_mm512_maskz_loadu_pd(valid, xs + j), vpx);
+        const __m512d dy = _mm512_sub_pd(_mm512_maskz_loadu_pd(valid, ys + j), vpy);
+        const __m512d distSq = _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy));
+        const __mmask8 lanes = _mm512_mask_cmp_pd_mask(valid, distSq, vr2, _CMP_LE_OQ);
+        mask |= static_cast<std::uint64_t>(lanes) << j;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+std::uint64_t withinAvx2F(float px, float py, const float* xs, const float* ys, size_t count,
+                          float sure, float maybe, std::uint64_t* uncertain) {
+    const __m256 vpx = _mm256_set1_ps(px);
+    const __m256 vpy = _mm256_set1_ps(py);
+    const __m256 vsure = _mm256_set1_ps(sure);
+    const __m256 vmaybe = _mm256_set1_ps(maybe);
+
+    std::uint64_t mask = 0;
+    std::uint64_t close = 0;
+    size_t j = 0;
+    for (; j + 8 <= count; j += 8) {
+        const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs + j), vpx);
+        const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys + j), vpy);
+        const __m256 distSq = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        mask |= static_cast<std::uint64_t>(_mm256_movemask_ps(_mm256_cmp_ps(distSq, vsure, _CMP_LE_OQ))) << j;
+        close |= static_cast<std::uint64_t>(_mm256_movemask_ps(_mm256_cmp_ps(distSq, vmaybe, _CMP_LE_OQ))) << j;
+    }
+    *uncertain = close & ~mask;
+    if (j < count) {
+        std::uint64_t tail;
+        mask |= withinScalarF(px, py, xs + j, ys + j, count - j, sure, maybe, &tail) << j;
+        *uncertain |= tail << j;
+    }
+    return mask;
+}
+
+__attribute__((target("avx512f")))
+std::uint64_t withinAvx512F(float px, float py, const float* xs, const float* ys, size_t count,
+                            float sure, float maybe, std::uint64_t* uncertain) {
+    const __m512 vpx = _mm512_set1_ps(px);
+    const __m512 vpy = _mm512_set1_ps(py);
+    const __m512 vsure = _mm512_set1_ps(sure);
+    const __m512 vmaybe = _mm512_set1_ps(maybe);
+
+    std::uint64_t mask = 0;
+    std::uint64_t close = 0;
+    for (size_t j = 0; j < count; j += 16) {
+        const __mmask16 valid = count - j >= 16 ? static_cast<__mmask16>(0xFFFF)
+                                                : static_cast<__mmask16>((1u << (count - j)) - 1);
+        const __m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(valid, xs + j), vpx);
+        const __m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(valid, ys + j), vpy);
+        const __m512 distSq = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+        mask |= static_cast<std::uint64_t>(_mm512_mask_cmp_ps_mask(valid, distSq, vsure, _CMP_LE_OQ)) << j;
+        close |= static_cast<std::uint64_t>(_mm512_mask_cmp_ps_mask(valid, distSq, vmaybe, _CMP_LE_OQ)) << j;
+    }
+    *uncertain = close & ~mask;
+    return mask;
+}
+
+#endif
+
+} // namespace
+
+bool supported(Isa isa) {
+#if DISTANCE_KERNEL_X86
+    __builtin_cpu_init();
+    if (isa == Isa::Avx512) return __builtin_cpu_supports("avx512f") != 0;
+    if (isa == Isa::Avx2) return __builtin_cpu_supports("avx2") != 0;
+#endif
+    return isa == Isa::Scalar;
+}
+
+Isa detect() {
+    static const Isa best = supported(Isa::Avx512) ? Isa::Avx512
+                          : supported(Isa::Avx2)   ? Isa::Avx2
+                                                   : Isa::Scalar;
+    return best;
+}
+
+BlockFn get(Isa isa) {
+#if DISTANCE_KERNEL_X86
+    if (isa == Isa::Avx512) return withinAvx512;
+    if (isa == Isa::Avx2) return withinAvx2;
+#else
+    (void)isa;
+#endif
+    return withinScalar;
+}
+
+BlockFnF getFloat(Isa isa) {
+#if DISTANCE_KERNEL_X86
+    if (isa == Isa::Avx512) return withinAvx512F;
+    if (isa == Isa::Avx2) return withinAvx2F;
+#else
+    (void)isa;
+#endif
+    return withinScalarF;
+}
+
+const char* name(Isa isa) {
+    switch (isa) {
+    case Isa::Avx512: return "avx512";
+    case Isa::Avx2: return "avx2";
+    default: return "scalar";
+    }
+}
+
+} // namespace distance_kernel
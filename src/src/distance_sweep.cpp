@@ -0,0 +1,107 @@
+/**
+ * @file distance_sweep.cpp
+ * @brief Edge lengths at the largest distance and filtering to smaller ones
+ */
+
+#include "distance_sweep.h"
+#include "distance_kernel.h"
+#include "parallel.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Relative margin around d^2 within which a float length is rechecked in
+// double: float rounding moves a length by at most 2^-24 of itself
+constexpr double RECHECK_MARGIN = 1.0 / (1 << 20);
+
+// Rows per parallel task
+constexpr size_t ROWS_PER_TASK = 4096;
+
+} // namespace
+
+DistanceSweep::DistanceSweep(NeighborhoodMgr& neighborMgr, const InstanceStore& instances, double maxDistance,
+                             unsigned threads)
+    : instances(instances), maxDist(maxDistance), threadCount(threads) {
+    if (!(maxDistance > 0.0)) throw std::invalid_argument("DistanceSweep: neighbor distance must be positive");
+    neighborMgr.materialize(instances, maxDistance);
+    graph = neighborMgr.takeGraph();
+
+    edgeDistSq.resize(graph.neighbors.size());
+    const size_t n = graph.size();
+    parallelFor((n + ROWS_PER_TASK - 1) / ROWS_PER_TASK, threadCount, [&](size_t task) {
+        for (size_t id = task * ROWS_PER_TASK; id < std::min(n, (task + 1) * ROWS_PER_TASK); ++id) {
+            for (std::uint64_t e = graph.offsets[id]; e < graph.offsets[id + 1]; ++e) {
+                const double dx = instances.x[graph.neighbors[e]] - instances.x[id];
+                const double dy = instances.y[graph.neighbors[e]] - instances.y[id];
+                edgeDistSq[e] = static_cast<float>(dx * dx + dy * dy);
+            }
+        }
+    });
+}
+
+NeighborGraph DistanceSweep::graphAt(double distance) const {
+    if (!(distance > 0.0) || distance > maxDist) {
+        throw std::invalid_argument("DistanceSweep: distance " + std::to_string(distance) + " is outside (0, " +
+                                    std::to_string(maxDist) + "]");
+    }
+    if (distance == maxDist) return graph;
+
+    static const distance_kernel::BlockFn withinDistance = distance_kernel::select();
+    const double r2 = distance * distance;
+    float sure = static_cast<float>(r2 * (1.0 - RECHECK_MARGIN));
+    float beyond = static_cast<float>(r2 * (1.0 + RECHECK_MARGIN));
+    if (r2 < 2.0 * std::numeric_limits<float>::min() / RECHECK_MARGIN ||
+        r2 > 0.5 * std::numeric_limits<float>::max()) {
+        // Outside the normal float range the margin does not hold: recheck all
+        sure = -1.0f;
+        beyond = std::numeric_limits<float>::infinity();
+    }
+    auto keep = [&](size_t id, std::uint64_t e) {
+        const float distSq = edgeDistSq[e];
+        if (distSq <= sure) return true;
+        if (distSq > beyond) return false;
+        // Same test, same rounding as the join at `distance`
+        const InstanceId other = graph.neighbors[e];
+        return withinDistance(instances.x[id], instances.y[id], &instances.x[other], &instances.y[other], 1, r2) != 0;
+    };
+
+    // Count the kept entries of each row, then copy them: rows keep their
+    // order, so the SNs kept stay in front
+    const size_t n = graph.size();
+    const size_t tasks = (n + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+    NeighborGraph filtered;
+    filtered.offsets.assign(n + 1, 0);
+    filtered.snCount.resize(n);
+    parallelFor(tasks, threadCount, [&](size_t task) {
+        for (size_t id = task * ROWS_PER_TASK; id < std::min(n, (task + 1) * ROWS_PER_TASK); ++id) {
+            const std::uint64_t first = graph.offsets[id];
+            std::uint32_t kept = 0, keptSns = 0;
+            for (std::uint64_t e = first; e < graph.offsets[id + 1]; ++e) {
+                if (!keep(id, e)) continue;
+                ++kept;
+                keptSns += e < first + graph.snCount[id];
+            }
+            filtered.offsets[id + 1] = kept;
+            filtered.snCount[id] = keptSns;
+        }
+    });
+    for (size_t id = 0; id < n; ++id) filtered.offsets[id + 1] += filtered.offsets[id];
+
+    filtered.neighbors.resize(filtered.offsets[n]);
+    parallelFor(tasks, threadCount, [&](size_t task) {
+        for (size_t id = task * ROWS_PER_TASK; id < std::min(n, (task + 1) * ROWS_PER_TASK); ++id) {
+            std::uint64_t out = filtered.offsets[id];
+            for (std::uint64_t e = graph.offsets[id]; e < graph.offsets[id + 1]; ++e) {
+                if (keep(id, e)) filtered.neighbors[out++] = graph.neighbors[e];
+            }
+        }
+    });
+    return filtered;
+}
+
+size_t DistanceSweep::memoryBytes() const {
+    return graph.memoryBytes() + edgeDistSq.capacity() * sizeof(float);
+}
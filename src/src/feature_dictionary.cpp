@@ -0,0 +1,75 @@
+/**
+ * @file feature_dictionary.cpp
+ * @brief Implementation of the interned feature-type dictionary
+ */
+
+#include "feature_dictionary.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+FeatureDictionary::FeatureDictionary(const FeatureDictionary& other)
+    : names_(other.names_) {
+    rebuildIndex();
+}
+
+FeatureDictionary& FeatureDictionary::operator=(const FeatureDictionary& other) {
+    if (this != &other) {
+        names_ = other.names_;
+        rebuildIndex();
+    }
+    return *this;
+}
+
+FeatureType FeatureDictionary::intern(std::string_view name) {
+    auto it = index_.find(name);
+    if (it != index_.end()) return it->second;
+
+    if (names_.size() > std::numeric_limits<FeatureType>::max()) {
+        throw std::length_error("FeatureDictionary: too many distinct feature types");
+    }
+    FeatureType code = static_cast<FeatureType>(names_.size());
+    names_.emplace_back(name);
+    index_.emplace(names_.back(), code);
+    return code;
+}
+
+std::vector<FeatureType> FeatureDictionary::finalize() {
+    // Sort the provisional codes by name, then invert the permutation.
+    std::vector<FeatureType> order(names_.size());
+    std::iota(order.begin(), order.end(), FeatureType(0));
+    std::sort(order.begin(), order.end(), [this](FeatureType a, FeatureType b) {
+        return names_[a] < names_[b];
+    });
+
+    std::vector<FeatureType> remap(names_.size());
+    std::deque<std::string> sorted;
+    for (size_t i = 0; i < order.size(); ++i) {
+        remap[order[i]] = static_cast<FeatureType>(i);
+        sorted.push_back(std::move(names_[order[i]]));
+    }
+    names_ = std::move(sorted);
+    rebuildIndex();
+    return remap;
+}
+
+bool FeatureDictionary::contains(std::string_view name) const {
+    return index_.find(name) != index_.end();
+}
+
+FeatureType FeatureDictionary::code(std::string_view name) const {
+    auto it = index_.find(name);
+    if (it == index_.end()) {
+        throw std::out_of_range("FeatureDictionary: unknown feature '" + std::string(name) + "'");
+    }
+    return it->second;
+}
+
+void FeatureDictionary::rebuildIndex() {
+    index_.clear();
+    index_.reserve(names_.size());
+    for (size_t i = 0; i < names_.size(); ++i) {
+        index_.emplace(names_[i], static_cast<FeatureType>(i));
+    }
+}
@@ -0,0 +1,79 @@
+/**
+ * @file kd_tree.cpp
+ * @brief Implementation of the static k-d tree
+ */
+
+#include "kd_tree.h"
+#include <algorithm>
+
+KdTree::KdTree(const InstanceStore& instances) {
+    if (instances.empty()) return;
+
+    const size_t n = instances.size();
+    ids.resize(n);
+    for (InstanceId id = 0; id < n; ++id) ids[id] = id;
+
+    // About 2n / LEAF_SIZE nodes for a tree with half-full to full leaves
+    nodes.reserve(4 * n / LEAF_SIZE + 1);
+    buildNode(instances, 0, static_cast<std::uint32_t>(n));
+
+    xs.resize(n);
+    ys.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        xs[i] = instances.x[ids[i]];
+        ys[i] = instances.y[ids[i]];
+    }
+}
+
+std::uint32_t KdTree::buildNode(const InstanceStore& instances, std::uint32_t first, std::uint32_t last) {
+    const std::uint32_t index = static_cast<std::uint32_t>(nodes.size());
+    BoundingBox box = BoundingBox::none();
+    for (std::uint32_t i = first; i < last; ++i) {
+        box.include(instances.x[ids[i]], instances.y[ids[i]]);
+    }
+    nodes.push_back({ box, first, last, 0 });
+    if (last - first <= LEAF_SIZE) return index;
+
+    // Median split along the longer side; ties by id keep the layout
+    // deterministic when many points share a coordinate
+    const std::vector<double>& axis = box.maxX - box.minX >= box.maxY - box.minY ? instances.x : instances.y;
+    const std::uint32_t middle = first + (last - first) / 2;
+    std::nth_element(ids.begin() + first, ids.begin() + middle, ids.begin() + last,
+                     [&axis](InstanceId a, InstanceId b) { return axis[a] < axis[b] || (axis[a] == axis[b] && a < b); });
+
+    buildNode(instances, first, middle);
+    const std::uint32_t right = buildNode(instances, middle, last);
+    nodes[index].right = right;
+    return index;
+}
+
+void KdTree::query(double x, double y, double radius, std::vector<InstanceId>& out) const {
+    if (nodes.empty()) return;
+    const double r2 = radius * radius;
+
+    // Depth is about log2(n / LEAF_SIZE); each level leaves at most one
+    // pending right child
+    std::uint32_t stack[64];
+    size_t top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (boxBeyond(node.box, x, y, r2)) continue;
+        if (boxWithin(node.box, x, y, r2)) {
+            out.insert(out.end(), ids.begin() + node.first, ids.begin() + node.last);
+            continue;
+        }
+        if (node.right == 0) {
+            appendWithin(x, y, ids.data() + node.first, xs.data() + node.first, ys.data() + node.first,
+                         node.last - node.first, r2, out);
+            continue;
+        }
+        stack[top++] = node.right;
+        stack[top++] = static_cast<std::uint32_t>(&node - nodes.data()) + 1;
+    }
+}
+
+size_t KdTree::memoryBytes() const {
+    return nodes.capacity() * sizeof(Node) + ids.capacity() * sizeof(InstanceId) +
+           (xs.capacity() + ys.capacity()) * sizeof(double);
+}
@@ -1,162 +1,237 @@
-﻿/**
- * @file main.cpp
- * @brief Chương trình chính kiểm thử thuật toán Clique-based Colocation Mining
- *
- * Quy trình:
- * 1. Load Config & Data
- * 2. Neighborhood Materialization (Algo 1)
- * 3. IDS - Instance Driven Search (Algo 2)
- * 4. Candidate Generation (Algo 4)
- * 5. Prevalent Filtering (Algo 5 & 6)
- */
-
-#include <iostream>
-#include <vector>
-#include <string>
-#include <map>
-
- // Include các header đã định nghĩa
-#include "config.h"
-#include "types.h"
-#include "neighborhood_mgr.h"
-#include "ids.h"
-#include "candidate_generation.h"
-#include "miner.h"
-
-// ============================================================================
-// HÀM HỖ TRỢ: TẠO DỮ LIỆU MẪU (DUMMY DATA)
-// ============================================================================
-std::vector<SpatialInstance> createSampleData() {
-    std::vector<SpatialInstance> data;
-    // Giả lập dữ liệu không gian: Type, ID, X, Y
-    // Tạo một số pattern colocation tiềm năng gần nhau
-
-    // Cụm 1: Có A, B, C gần nhau
-    data.push_back({ "A", "A1", 1.0, 1.0 });
-    data.push_back({ "B", "B1", 1.2, 1.1 });
-    data.push_back({ "C", "C1", 1.1, 1.3 });
-
-    // Cụm 2: Có A, B gần nhau (không có C)
-    data.push_back({ "A", "A2", 5.0, 5.0 });
-    data.push_back({ "B", "B2", 5.1, 5.2 });
-
-    // Cụm 3: Có B, C gần nhau
-    data.push_back({ "B", "B3", 10.0, 10.0 });
-    data.push_back({ "C", "C2", 10.2, 10.1 });
-
-    // Nhiễu (Noise): Đứng một mình
-    data.push_back({ "A", "A3", 20.0, 20.0 });
-    data.push_back({ "D", "D1", 50.0, 50.0 });
-
-    return data;
-}
-
-// Hàm hỗ trợ in kết quả pattern (Colocation là vector<string>)
-void printPattern(const Colocation& pattern) {
-    std::cout << "{ ";
-    for (size_t i = 0; i < pattern.size(); ++i) {
-        std::cout << pattern[i] << (i < pattern.size() - 1 ? ", " : " ");
-    }
-    std::cout << "}";
-}
-
-// ============================================================================
-// MAIN FUNCTION
-// ============================================================================
-int main() {
-    try {
-        std::cout << "=== STARTING CLIQUE-BASED COLOCATION MINING ===\n" << std::endl;
-
-        // ---------------------------------------------------------
-        // BƯỚC 0: Cấu hình và Dữ liệu
-        // ---------------------------------------------------------
-        // Load configurations from file
-        // Note: Assuming executable is run from the directory containing config.txt
-        AppConfig config = ConfigLoader::load("config.txt");
-        
-        std::cout << "Configuration Loaded:" << std::endl;
-        std::cout << " - Neighbor Distance: " << config.neighborDistance << std::endl;
-        std::cout << " - Min Prevalence: " << config.minPrev << std::endl;
-        std::cout << " - Dataset Path: " << config.datasetPath << std::endl;
-
-        std::cout << "\nLoading data..." << std::endl;
-        std::vector<SpatialInstance> data = DataLoader::load_csv(config.datasetPath);
-        if (data.empty()) {
-             std::cout << "Warning: No data loaded or file not found at '" << config.datasetPath << "'." << std::endl;
-        }
-        std::cout << "Loaded " << data.size() << " spatial instances.\n" << std::endl;
-
-        // ---------------------------------------------------------
-        // BƯỚC 1: Neighborhood Materialization (Algorithm 1)
-        // ---------------------------------------------------------
-        std::cout << ">>> Step 1: Running Neighborhood Materialization..." << std::endl;
-        NeighborhoodMgr neighborMgr(config.neighborDistance);
-
-        // Gọi hàm materialize để tính toán BNs, SNs
-        neighborMgr.materialize(data);
-
-        std::cout << "Neighborhoods materialized." << std::endl;
-
-        // ---------------------------------------------------------
-        // BƯỚC 2: IDS Algorithm (Algorithm 2)
-        // ---------------------------------------------------------
-        std::cout << "\n>>> Step 2: Running IDS (Instance-Driven Search)..." << std::endl;
-
-        // Khởi tạo IDSMiner với map hàng xóm từ bước 1
-        IDSMiner idsMiner(neighborMgr.getAllNeighbors());
-
-        // Chạy thuật toán tìm Row-instances cliques (I-Cliques)
-        std::vector<ColocationInstance> cliques = idsMiner.run(data);
-
-        std::cout << "Found " << cliques.size() << " cliques (row instances)." << std::endl;
-
-        // ---------------------------------------------------------
-        // BƯỚC 3: Candidate Generation (Algorithm 4)
-        // ---------------------------------------------------------
-        std::cout << "\n>>> Step 3: Generating Candidates..." << std::endl;
-        CandidateGenerator candidateGen;
-
-        // Chuyển đổi từ I-Cliques sang cấu trúc C-Hash
-        CHash cHash = candidateGen.generate(cliques);
-
-        std::cout << "C-Hash structure built. Keys generated: " << cHash.data.size() << std::endl;
-
-        // ---------------------------------------------------------
-        // BƯỚC 4: Prevalent Co-locations Filtering (Algorithm 5)
-        // ---------------------------------------------------------
-        std::cout << "\n>>> Step 4: Filtering Prevalent Co-locations..." << std::endl;
-
-        /* Lưu ý: Để tính PI chính xác (Algorithm 6), Miner cần biết tổng số lượng
-           của từng Feature (Global Counts) để chia mẫu số.
-           Trong file miner.h bạn định nghĩa chỉ nhận minPrev, nên ở đây ta giả định
-           CoLocationMiner sẽ tự đếm hoặc được set dữ liệu này bên trong.
-        */
-        CoLocationMiner miner(config.minPrev);
-
-        // Thực hiện lọc và tính PI
-        ResultList results = miner.filter(cHash);
-
-        // ---------------------------------------------------------
-        // KẾT QUẢ
-        // ---------------------------------------------------------
-        std::cout << "\n=== FINAL RESULTS (Prevalent Co-locations) ===" << std::endl;
-        if (results.results.empty()) {
-            std::cout << "No prevalent patterns found." << std::endl;
-        }
-        else {
-            for (const auto& res : results.results) {
-                // res.first là Colocation (vector<string>), res.second là PI (double)
-                std::cout << "Pattern: ";
-                printPattern(res.first);
-                std::cout << " | PI: " << res.second << std::endl;
-            }
-        }
-
-    }
-    catch (const std::exception& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
-        return 1;
-    }
-
-    return 0;
+﻿/**
+ * @file main.cpp
+ * @brief Chương trình chính kiểm thử thuật toán Clique-based Colocation Mining
+ *
+ * Quy trình:
+ * 1. Load Config & Data
+ * 2. Neighborhood Materialization (Algo 1)
+ * 3. IDS - Instance Driven Search (Algo 2)
+ * 4. Candidate Generation (Algo 4)
+ * 5. Prevalent Filtering (Algo 5 & 6)
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <map>
+#include <utility>
+#include <optional>
+#include <stdexcept>
+
+ // Include các header đã định nghĩa
+#include "config.h"
+#include "types.h"
+#include "instance_store.h"
+#include "data_loader.h"
+#include "neighborhood_mgr.h"
+#include "tiled_neighborhood.h"
+#include "distance_sweep.h"
+#include "ids_tree.h"
+#include "candidate_generation.h"
+#include "miner.h"
+#include "utils.h"
+
+// ============================================================================
+// MAIN FUNCTION
+// ============================================================================
+int main() {
+    try {
+        std::cout << "=== STARTING CLIQUE-BASED COLOCATION MINING ===\n" << std::endl;
+
+        // ---------------------------------------------------------
+        // BƯỚC 0: Cấu hình và Dữ liệu
+        // ---------------------------------------------------------
+        // Load configurations from file
+        // Note: Assuming executable is run from the directory containing config.txt
+        AppConfig config = ConfigLoader::load("config.txt");
+        
+        std::cout << "Configuration Loaded:" << std::endl;
+        std::cout << " - Neighbor Distance: " << config.neighborDistance << std::endl;
+        std::cout << " - Min Prevalence: " << config.minPrev << std::endl;
+        std::cout << " - Dataset Path: " << config.datasetPath << std::endl;
+        std::cout << " - Loader: " << config.loaderMode << std::endl;
+        std::cout << " - Spatial Index: " << config.spatialIndex << std::endl;
+        std::cout << " - Threads: " << config.numThreads << std::endl;
+        if (!config.featureFilter.empty()) {
+            std::cout << " - Feature Filter:";
+            for (const auto& name : config.featureFilter) std::cout << " " << name;
+            std::cout << std::endl;
+        }
+        if (config.bbox) {
+            std::cout << " - BBox: (" << config.bbox->minX << ", " << config.bbox->minY << ") - ("
+                      << config.bbox->maxX << ", " << config.bbox->maxY << ")" << std::endl;
+        }
+
+        std::cout << "\nLoading data..." << std::endl;
+        LoadOptions loadOptions;
+        loadOptions.loader = config.loaderMode;
+        loadOptions.threads = config.numThreads;
+        loadOptions.features = config.featureFilter;
+        loadOptions.bbox = config.bbox;
+        InstanceStore data;
+        const SpatialIndexKind indexKind = parseSpatialIndexKind(config.spatialIndex);
+        if (config.streamToGrid && indexKind != SpatialIndexKind::Grid) {
+            throw std::invalid_argument("stream_to_grid needs spatial_index=grid, not '" + config.spatialIndex + "'");
+        }
+        std::optional<SpatialGrid> grid;
+        // Lưới dựng khi load chỉ dùng cho một đồ thị toàn cục ở neighbor_distance:
+        // chế độ tile tự chia dữ liệu, sweep materialize ở khoảng cách lớn nhất
+        if (config.streamToGrid && config.tileDir.empty() && config.neighborDistances.empty()) {
+            GriddedDataset dataset = DataLoader::load_gridded(config.datasetPath, loadOptions, config.neighborDistance);
+            data = std::move(dataset.instances);
+            grid = std::move(dataset.grid);
+        } else {
+            data = DataLoader::load(config.datasetPath, loadOptions);
+        }
+        const FeatureDictionary& features = data.features;
+        if (data.empty()) {
+             std::cout << "Warning: No data loaded or file not found at '" << config.datasetPath << "'." << std::endl;
+        }
+        std::cout << "Loaded " << data.size() << " spatial instances of "
+                  << features.size() << " feature types.\n" << std::endl;
+
+        // Convert once: later runs can point dataset_path at the snapshot
+        if (!config.snapshotPath.empty() && !DataLoader::isSnapshotPath(config.datasetPath)) {
+            DataLoader::save_snapshot(data, config.snapshotPath);
+            std::cout << "Snapshot written to '" << config.snapshotPath << "'.\n" << std::endl;
+        }
+
+        // ---------------------------------------------------------
+        // BƯỚC 1: Neighborhood Materialization (Algorithm 1)
+        // ---------------------------------------------------------
+        std::cout << ">>> Step 1: Running Neighborhood Materialization..." << std::endl;
+        NeighborhoodMgr neighborMgr;
+        neighborMgr.setThreadCount(config.numThreads);
+        neighborMgr.setSpatialIndex(indexKind);
+        if (config.materializeMode == "two_pass") {
+            neighborMgr.setMaterializeMode(MaterializeMode::TwoPass);
+        } else if (config.materializeMode != "buffered") {
+            throw std::invalid_argument("Unknown materialize_mode '" + config.materializeMode + "'");
+        }
+        neighborMgr.setMemoryBudget(config.memoryBudgetMB * 1024 * 1024);
+        if (config.coordinatePrecision == "float") {
+            neighborMgr.setCoordinatePrecision(CoordinatePrecision::Float);
+        } else if (config.coordinatePrecision != "double") {
+            throw std::invalid_argument("Unknown coordinate_precision '" + config.coordinatePrecision + "'");
+        }
+
+        neighborMgr.setCacheDirectory(config.neighborCacheDir);
+
+        // Gọi hàm materialize để tính toán BNs, SNs
+        std::vector<double> distances = config.neighborDistances;
+        std::sort(distances.begin(), distances.end());
+        distances.erase(std::unique(distances.begin(), distances.end()), distances.end());
+        std::optional<DistanceSweep> sweep;
+        std::optional<TiledNeighborhood> tiles;
+        if (!distances.empty()) {
+            if (!config.tileDir.empty()) {
+                throw std::invalid_argument("neighbor_distances cannot be combined with tile_dir");
+            }
+            // Materialize một lần ở khoảng cách lớn nhất, các ngưỡng nhỏ hơn chỉ lọc cạnh
+            sweep.emplace(neighborMgr, data, distances.back(), config.numThreads);
+            std::cout << "Sweep over " << distances.size() << " distances, materialized at "
+                      << distances.back() << "." << std::endl;
+        } else if (!config.tileDir.empty()) {
+            // Chia tile, tính láng giềng từng tile rồi ghi ra đĩa
+            tiles.emplace(config.tileDir, config.neighborDistance, config.tilePoints);
+            // Có snapshot đúng với `data` thì chia tile bằng cách đọc thẳng file
+            // (không cần cả tập dữ liệu trong bộ nhớ), ngược lại chia từ `data`
+            std::string tileSource;
+            if (!DataLoader::isSnapshotPath(config.datasetPath)) {
+                tileSource = config.snapshotPath;   // Đã ghi từ `data` ở trên (rỗng nếu không cấu hình)
+            } else if (!DataLoader::isMultiFilePath(config.datasetPath) && !loadOptions.filters()) {
+                tileSource = config.datasetPath;
+            }
+            if (!tileSource.empty()) tiles->partition(tileSource);
+            else tiles->partition(data);
+            tiles->materialize(neighborMgr);
+            std::cout << "Tiles written: " << tiles->tiles().size() << std::endl;
+        } else if (grid) {
+            neighborMgr.materialize(data, *grid, config.neighborDistance);
+        } else {
+            neighborMgr.materialize(data, config.neighborDistance);
+        }
+        if (distances.empty()) distances.push_back(config.neighborDistance);
+
+        std::cout << (neighborMgr.loadedFromCache() ? "Neighborhoods loaded from cache." : "Neighborhoods materialized.")
+                  << std::endl;
+
+        // Bước 2-4 cho từng ngưỡng khoảng cách (một ngưỡng nếu không sweep)
+        for (double distance : distances) {
+            if (sweep) {
+                neighborMgr.setGraph(sweep->graphAt(distance));
+                std::cout << "\n=== Neighbor Distance: " << distance << " ===" << std::endl;
+            }
+
+            // ---------------------------------------------------------
+            // BƯỚC 2: IDS Algorithm (Algorithm 2)
+            // ---------------------------------------------------------
+            std::cout << "\n>>> Step 2: Running IDS (Instance-Driven Search)..." << std::endl;
+
+            CandidateGenerator candidateGen;
+            CHashStructure cHash;
+            if (tiles) {
+                // Out-of-core: clique của các tile đến dần theo thứ tự head và vào
+                // thẳng C-Hash (bước 3), không giữ cả danh sách clique trong bộ nhớ
+                size_t cliqueCount = 0;
+                tiles->runIds([&](const std::vector<InstanceId>& clique) {
+                    candidateGen.AddClique(clique, data, cHash);
+                    ++cliqueCount;
+                });
+                std::cout << "Found " << cliqueCount << " cliques (row instances)." << std::endl;
+                std::cout << "\n>>> Step 3: Generating Candidates... (built while streaming the tiles)" << std::endl;
+            } else {
+                // Khởi tạo IDSTree với đồ thị láng giềng từ bước 1
+                IDSTree idsTree(neighborMgr, data);
+
+                // Chạy thuật toán tìm Row-instances cliques (I-Cliques)
+                std::vector<ColocationInstance> cliques = idsTree.run();
+
+                std::cout << "Found " << cliques.size() << " cliques (row instances)." << std::endl;
+
+                // ---------------------------------------------------------
+                // BƯỚC 3: Candidate Generation (Algorithm 4)
+                // ---------------------------------------------------------
+                std::cout << "\n>>> Step 3: Generating Candidates..." << std::endl;
+
+                // Chuyển đổi từ I-Cliques sang cấu trúc C-Hash
+                cHash = candidateGen.Candidate_generation(cliques, data);
+            }
+
+            std::cout << "C-Hash structure built. Keys generated: " << cHash.size() << std::endl;
+
+            // ---------------------------------------------------------
+            // BƯỚC 4: Prevalent Co-locations Filtering (Algorithm 5)
+            // ---------------------------------------------------------
+            std::cout << "\n>>> Step 4: Filtering Prevalent Co-locations..." << std::endl;
+
+            // Thực hiện lọc và tính PI (tổng số instance của từng feature lấy từ data)
+            PrevalentColocationMiner miner(data);
+            const std::map<PatternKey, double> results = miner.mineColocations(cHash, config.minPrev);
+
+            // ---------------------------------------------------------
+            // KẾT QUẢ
+            // ---------------------------------------------------------
+            std::cout << "\n=== FINAL RESULTS (Prevalent Co-locations) ===" << std::endl;
+            if (results.empty()) {
+                std::cout << "No prevalent patterns found." << std::endl;
+            }
+            else {
+                for (const auto& res : results) {
+                    // res.first là Colocation (mã feature), res.second là PI (double)
+                    std::cout << "Pattern: ";
+                    printPattern(res.first, features);
+                    std::cout << " | PI: " << res.second << std::endl;
+                }
+            }
+        }
+
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+/**
+ * @file mapped_file.cpp
+ * @brief Implementation of the read-only file mapping (POSIX mmap / Win32 file mapping)
+ */
+
+#include "mapped_file.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("MappedFile: cannot open '" + path + "'");
+    }
+    file_ = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        throw std::runtime_error("MappedFile: cannot stat '" + path + "'");
+    }
+    size_ = static_cast<std::size_t>(size.QuadPart);
+    if (size_ == 0) return;
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        throw std::runtime_error("MappedFile: cannot map '" + path + "'");
+    }
+    mapping_ = mapping;
+
+    data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("MappedFile: cannot map '" + path + "'");
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(static_cast<HANDLE>(mapping_));
+    if (file_) CloseHandle(static_cast<HANDLE>(file_));
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        throw std::runtime_error("MappedFile: cannot open '" + path + "'");
+    }
+
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+        ::close(fd_);
+        throw std::runtime_error("MappedFile: cannot stat '" + path + "'");
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ == 0) return;
+
+    void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (addr == MAP_FAILED) {
+        ::close(fd_);
+        throw std::runtime_error("MappedFile: cannot map '" + path + "'");
+    }
+    // The file is read front to back; let the kernel read ahead aggressively.
+    ::madvise(addr, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(addr);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) ::munmap(const_cast<char*>(data_), size_);
+    if (fd_ >= 0) ::close(fd_);
+}
+
+#endif
@@ -0,0 +1,76 @@
+#include "miner.h"
+
+#include <set>
+
+PrevalentColocationMiner::PrevalentColocationMiner(const InstanceStore& instances)
+    : featureCount(instances.features.size(), 0) {
+    for (FeatureType t : instances.type) ++featureCount[t];
+}
+
+std::vector<PatternKey> PrevalentColocationMiner::GetAllSubsets(const PatternKey& candidate) {
+    std::vector<PatternKey> subsets;
+    for (size_t skip = 0; skip < candidate.size(); ++skip) {
+        PatternKey subset;
+        for (size_t i = 0; i < candidate.size(); ++i) {
+            if (i != skip) subset.push_back(candidate[i]);
+        }
+        subsets.push_back(std::move(subset));
+    }
+    return subsets;
+}
+
+// ==================================================================================
+// ALGORITHM 5: Prevalent co-locations filtering
+// ==================================================================================
+std::map<PatternKey, double> PrevalentColocationMiner::mineColocations(const CHashStructure& chash, double minPrev) {
+    std::map<PatternKey, double> prevalent;
+    CalculatePI calculator;
+
+    // Thêm candidate vào kết quả nếu có row instance và PI >= minPrev:
+    // PI = min theo feature f của (số instance tham gia của f) / (số instance của f)
+    auto keepIfPrevalent = [&](const PatternKey& candidate) {
+        const std::vector<std::vector<InstanceId>> columns = calculator.calculatePI(chash, candidate);
+        if (columns.front().empty()) return false;
+        double pi = 1.0;
+        for (size_t i = 0; i < candidate.size(); ++i) {
+            pi = std::min(pi, static_cast<double>(columns[i].size()) / static_cast<double>(featureCount[candidate[i]]));
+        }
+        if (pi < minPrev) return false;
+        prevalent.emplace(candidate, pi);
+        return true;
+    };
+
+    // Mức 2: các cặp feature cùng xuất hiện trong một khóa
+    std::set<PatternKey> pairs;
+    for (const auto& entry : chash) {
+        const PatternKey& key = entry.first;
+        for (size_t i = 0; i < key.size(); ++i) {
+            for (size_t j = i + 1; j < key.size(); ++j) pairs.insert({ key[i], key[j] });
+        }
+    }
+    std::vector<PatternKey> level;   // Mẫu phổ biến của mức hiện tại, tăng dần
+    for (const PatternKey& candidate : pairs) {
+        if (keepIfPrevalent(candidate)) level.push_back(candidate);
+    }
+
+    // Mức k + 1 từ hai mẫu mức k có chung k - 1 feature đầu; level tăng dần
+    // nên các mẫu đó đứng liền nhau, và ứng viên sinh ra cũng tăng dần
+    while (level.size() > 1) {
+        std::vector<PatternKey> next;
+        for (size_t a = 0; a < level.size(); ++a) {
+            for (size_t b = a + 1; b < level.size() && std::equal(level[a].begin(), level[a].end() - 1,
+                                                                  level[b].begin());
+                 ++b) {
+                PatternKey candidate = level[a];
+                candidate.push_back(level[b].back());
+                const std::vector<PatternKey> subsets = GetAllSubsets(candidate);
+                const bool closed = std::all_of(subsets.begin(), subsets.end(), [&](const PatternKey& subset) {
+                    return std::binary_search(level.begin(), level.end(), subset);
+                });
+                if (closed && keepIfPrevalent(candidate)) next.push_back(std::move(candidate));
+            }
+        }
+        level = std::move(next);
+    }
+    return prevalent;
+}
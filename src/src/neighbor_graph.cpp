@@ -0,0 +1,127 @@
+/**
+ * @file neighbor_graph.cpp
+ * @brief Spilling a NeighborGraph to disk and reading it back
+ */
+
+#include "neighbor_graph.h"
+#include "cbin_format.h"
+#include "mapped_file.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr char MAGIC[8] = { 'C', 'L', 'Q', 'C', 'S', 'R', '\0', '\0' };
+constexpr std::uint32_t VERSION = 1;
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint64_t rows;
+    std::uint64_t entries;
+    std::uint64_t offsetsOffset;      ///< rows + 1 x uint64
+    std::uint64_t snCountOffset;      ///< rows x uint32
+    std::uint64_t neighborsOffset;    ///< entries x InstanceId
+};
+
+std::runtime_error graphError(const std::string& path, const std::string& what) {
+    return std::runtime_error("NeighborGraph: '" + path + "': " + what);
+}
+
+template <typename T>
+void writeArray(std::ofstream& out, std::uint64_t& offset, std::uint64_t target, const std::vector<T>& array) {
+    static const char zeros[cbin::COLUMN_ALIGN] = {};
+    out.write(zeros, static_cast<std::streamsize>(target - offset));
+    out.write(reinterpret_cast<const char*>(array.data()), static_cast<std::streamsize>(array.size() * sizeof(T)));
+    offset = target + array.size() * sizeof(T);
+}
+
+template <typename T>
+void readArray(const MappedFile& file, std::uint64_t offset, std::uint64_t count, std::vector<T>& array) {
+    array.resize(count);
+    std::memcpy(array.data(), file.data() + offset, count * sizeof(T));
+}
+
+} // namespace
+
+void NeighborGraph::save(const std::string& path) const {
+    // A default-constructed graph has no offsets yet; on disk it has the one 0
+    const std::vector<std::uint64_t> noRows(1, 0);
+    const std::vector<std::uint64_t>& rowStarts = offsets.empty() ? noRows : offsets;
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.byteOrder = cbin::BYTE_ORDER_MARK;
+    header.rows = size();
+    header.entries = neighbors.size();
+    header.offsetsOffset = cbin::alignUp(sizeof(Header));
+    header.snCountOffset = cbin::alignUp(header.offsetsOffset + rowStarts.size() * sizeof(std::uint64_t));
+    header.neighborsOffset = cbin::alignUp(header.snCountOffset + snCount.size() * sizeof(std::uint32_t));
+
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) throw graphError(path, "cannot create '" + tmpPath + "'");
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        std::uint64_t offset = sizeof(header);
+        writeArray(out, offset, header.offsetsOffset, rowStarts);
+        writeArray(out, offset, header.snCountOffset, snCount);
+        writeArray(out, offset, header.neighborsOffset, neighbors);
+
+        if (!out.flush()) throw graphError(path, "write failed");
+    }
+
+    // Replaces an existing file in one step (rename(2) on POSIX), so a crash
+    // leaves either the old file or the new one under the real name
+    std::error_code error;
+    std::filesystem::rename(tmpPath, path, error);
+    if (error) throw graphError(path, "cannot rename '" + tmpPath + "': " + error.message());
+}
+
+NeighborGraph NeighborGraph::load(const std::string& path) {
+    MappedFile file(path);
+    if (file.size() < sizeof(Header)) throw graphError(path, "file too small");
+
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0) throw graphError(path, "not a graph file");
+    if (header.byteOrder != cbin::BYTE_ORDER_MARK) {
+        throw graphError(path, "written on a machine with a different byte order");
+    }
+    if (header.version != VERSION) {
+        throw graphError(path, "unsupported version " + std::to_string(header.version));
+    }
+
+    const std::uint64_t fileSize = file.size();
+    auto inside = [&](std::uint64_t offset, std::uint64_t bytes) {
+        return offset <= fileSize && bytes <= fileSize - offset;
+    };
+    if (header.rows >= fileSize || header.entries > fileSize ||
+        !inside(header.offsetsOffset, (header.rows + 1) * sizeof(std::uint64_t)) ||
+        !inside(header.snCountOffset, header.rows * sizeof(std::uint32_t)) ||
+        !inside(header.neighborsOffset, header.entries * sizeof(InstanceId))) {
+        throw graphError(path, "truncated or corrupt section table");
+    }
+
+    NeighborGraph graph;
+    readArray(file, header.offsetsOffset, header.rows + 1, graph.offsets);
+    readArray(file, header.snCountOffset, header.rows, graph.snCount);
+    readArray(file, header.neighborsOffset, header.entries, graph.neighbors);
+
+    // Rows must tile the neighbor array and SN counts fit their rows, so that
+    // the spans handed out later stay in bounds
+    if (graph.offsets.front() != 0 || graph.offsets.back() != header.entries) {
+        throw graphError(path, "row offsets do not match the entry count");
+    }
+    for (size_t i = 0; i < header.rows; ++i) {
+        if (graph.offsets[i + 1] < graph.offsets[i] || graph.snCount[i] > graph.offsets[i + 1] - graph.offsets[i]) {
+            throw graphError(path, "inconsistent row " + std::to_string(i));
+        }
+    }
+    return graph;
+}
@@ -1,168 +1,828 @@
 #include "neighborhood_mgr.h"
+#include "parallel.h"
+#include "distance_kernel.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace {
+
+// Rows at least this long are radix sorted; shorter ones use std::sort
+constexpr size_t RADIX_ROW_MIN = 256;
+
+// Cells with fewer points are scanned whole: keeping a sweep window costs
+// more than the distance tests it would save
+constexpr size_t SWEEP_MIN_POINTS = 16;
+
+// Float mode: squared distances within FLOAT_MARGIN * reach^2 of the
+// threshold are rechecked in double. Offsets are at most about 3 * reach
+// apart and carry a few float roundings (2^-24 each), which bounds the float
+// error of a squared distance by about 2^-16 * reach^2; the margin leaves a
+// factor 16 on top.
+constexpr double FLOAT_MARGIN = 1.0 / 4096.0;
+
+// Float mode needs the double offsets from the cell origins to be exact to
+// well below the margin, so coordinates may be at most this many reaches
+// away from 0
+constexpr double FLOAT_MAX_REACHES = 1073741824.0;   // 2^30
+
+// Sort one CSR row of ids below 2^idBits. Long rows arrive in no particular
+// order (cells are scanned by x), where an LSD radix sort on 11-bit digits
+// beats comparison sorting; `scratch` is reused between rows.
+void sortRow(InstanceId* row, size_t length, unsigned idBits, std::vector<InstanceId>& scratch) {
+    if (length < RADIX_ROW_MIN) {
+        std::sort(row, row + length);
+        return;
+    }
+    constexpr unsigned DIGIT_BITS = 11;
+    constexpr size_t BUCKETS = size_t(1) << DIGIT_BITS;
+
+    scratch.resize(length);
+    InstanceId* src = row;
+    InstanceId* dst = scratch.data();
+    size_t count[BUCKETS];
+    for (unsigned shift = 0; shift < idBits; shift += DIGIT_BITS) {
+        std::fill(count, count + BUCKETS, 0);
+        for (size_t i = 0; i < length; ++i) ++count[(src[i] >> shift) & (BUCKETS - 1)];
+
+        size_t sum = 0;
+        for (size_t& c : count) {
+            size_t k = c;
+            c = sum;
+            sum += k;
+        }
+        for (size_t i = 0; i < length; ++i) {
+            dst[count[(src[i] >> shift) & (BUCKETS - 1)]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if (src != row) std::copy(src, src + length, row);
+}
 
-
-std::vector<Grid> NeighborhoodMgr::divideSpace(double distanceThreshold, const std::vector<SpatialInstance>& instances){
-    // Early exit if there are no instances to process.
-    if (instances.empty()) {
-        return {};
+// Rows are split into SNs and BNs by sorting neighbor ids, which only
+// compares features when the ids are grouped by feature
+void requireFeatureMajor(const InstanceStore& instances, const char* caller) {
+    if (!instances.featureMajor && !instances.empty()) {
+        throw std::invalid_argument(std::string("NeighborhoodMgr: ") + caller +
+                                    " needs feature-major instances (sortSpatially() order)");
     }
+}
+
+} // namespace
 
-    // 1. Calculate the bounding box (min/max coordinates) of the dataset.
-    double min_x = instances[0].x;
-    double min_y = instances[0].y;
-    double max_x = instances[0].x;
-    double max_y = instances[0].y;
 
-    for (const auto& inst : instances) {
-        if (inst.x < min_x) min_x = inst.x;
-        if (inst.y < min_y) min_y = inst.y;
-        if (inst.x > max_x) max_x = inst.x;
-        if (inst.y > max_y) max_y = inst.y;
+SpatialGrid NeighborhoodMgr::divideSpace(double distanceThreshold, const InstanceStore& instances){
+    // Cell side = distance threshold; the bounding box is kept by the store,
+    // so this is a counting sort into the flat cell arrays
+    return SpatialGrid::build(instances, distanceThreshold);
+};
+
+
+void NeighborhoodMgr::getForwardNeighborCells(size_t cellId, const SpatialGrid& grid,
+                                              const std::vector<CellOffset>& stencil,
+                                              std::vector<size_t>& neighbor_cells) const {
+    // Half stencil: of the surrounding cells only those "after" the cell in
+    // row-major order. Each unordered pair of cells is then visited from
+    // exactly one side.
+    neighbor_cells.assign(stencil.size(), SpatialGrid::NO_CELL);
+
+	// 1. Calculate current grid's 2D coordinates (dense or sparse layout)
+    const CellCoord cur = grid.coordOf(cellId);
+
+    for (size_t i = 0; i < stencil.size(); ++i) {
+        const CellOffset offset = stencil[i];
+        // 2. Check bounds (coordinates are unsigned: test before stepping left)
+        if (offset.dx < 0 && cur.cx < std::uint64_t(-offset.dx)) continue;
+        if (offset.dx > 0 && grid.cellsX - cur.cx <= std::uint64_t(offset.dx)) continue;
+        if (offset.dy > 0 && grid.cellsY - cur.cy <= std::uint64_t(offset.dy)) continue;
+
+        // 3. Add the neighbor grid if it is stored and holds instances
+        const size_t ngrid = grid.findCell({ cur.cx + offset.dx, cur.cy + offset.dy });
+        if (ngrid != SpatialGrid::NO_CELL && !grid.cell(ngrid).empty()) {
+            neighbor_cells[i] = ngrid;
+        }
     }
+}
 
-    // 2. Determine grid dimensions based on the distance threshold.
-    this->gridCellsX = static_cast<size_t>(std::ceil((max_x - min_x) / distanceThreshold));
-    this->gridCellsY = static_cast<size_t>(std::ceil((max_y - min_y) / distanceThreshold));
 
-    // Ensure at least one cell exists (handles cases where min == max).
-    if (gridCellsX == 0) gridCellsX = 1;
-    if (gridCellsY == 0) gridCellsY = 1;
+template <typename Visit>
+void NeighborhoodMgr::joinGrid(const SpatialGrid& grid, const InstanceStore& instances, double distanceThreshold,
+                               unsigned threads, size_t bandCount, Visit visit) const {
+    const std::vector<FeatureType>& types = instances.type;
+
+    // Band b owns cells [cells * b / bandCount, cells * (b + 1) / bandCount).
+    // Its forward cells may lie in another band, but those are only read.
+    const size_t cells = grid.cellCount();
+
+    // Is_Neighbor runs one instance against a whole block of cell-ordered
+    // coordinates at a time (AVX-512/AVX2 when the CPU has them)
+    const distance_kernel::BlockFn withinDistance = distance_kernel::select();
+    const double distSq = distanceThreshold * distanceThreshold;
+
+    // Float mode: float offsets of every point from the origin of its cell,
+    // in cell order. A point of cell B seen from cell A = B - (dx, dy) is at
+    // its offset + (dx, dy) * cellSize from A's origin.
+    const BoundingBox& box = instances.bounds;
+    const double farthest = std::max(std::max(std::abs(box.minX), std::abs(box.maxX)),
+                                     std::max(std::abs(box.minY), std::abs(box.maxY)));
+    const bool useFloat = precision == CoordinatePrecision::Float && cells > 0 &&
+                          farthest <= FLOAT_MAX_REACHES * grid.reach;
+    const distance_kernel::BlockFnF withinDistanceF = distance_kernel::selectFloat();
+    const double margin = FLOAT_MARGIN * grid.reach * grid.reach;
+    const float sureSq = static_cast<float>(distSq - margin);
+    const float maybeSq = static_cast<float>(distSq + margin);
+    std::vector<float> fx, fy;
+    if (useFloat) {
+        fx.resize(grid.cellInstances.size());
+        fy.resize(grid.cellInstances.size());
+        parallelFor(bandCount, threads, [&](size_t band) {
+            for (size_t c = cells * band / bandCount; c < cells * (band + 1) / bandCount; ++c) {
+                const CellCoord coord = grid.coordOf(c);
+                const double originX = grid.minX + static_cast<double>(coord.cx) * grid.cellSize;
+                const double originY = grid.minY + static_cast<double>(coord.cy) * grid.cellSize;
+                for (size_t i = grid.cellStart[c]; i < grid.cellStart[c + 1]; ++i) {
+                    fx[i] = static_cast<float>(grid.cellX[i] - originX);
+                    fy[i] = static_cast<float>(grid.cellY[i] - originY);
+                }
+            }
+        });
+    }
 
-    // 3. Initialize the grid cells with IDs.
-    std::vector<Grid> dividedSpace(gridCellsX * gridCellsY);
-    for (size_t i = 0; i < dividedSpace.size(); ++i) {
-        dividedSpace[i].grid_id = i;
+    // Visit every unordered pair of candidate instances once (own cell, then
+    // the forward cells) and report each neighbor pair as one edge (smaller
+    // feature, bigger feature).
+
+    // Forward stencil of the grid's refinement, and for each of its columns
+    // whether two points can be more than d apart along x (the sweep below
+    // can only cut anything there)
+    const std::vector<CellOffset> stencil = grid.forwardStencil();
+    std::vector<char> sweepColumn(stencil.size());
+    for (size_t k = 0; k < stencil.size(); ++k) {
+        sweepColumn[k] = (std::abs(stencil[k].dx) + 1) * grid.cellSize > distanceThreshold;
     }
+    const bool sweepOwnColumn = grid.cellSize > distanceThreshold;
+    std::vector<float> shiftX(stencil.size() + 1, 0.0f), shiftY(stencil.size() + 1, 0.0f);
+    for (size_t k = 0; k < stencil.size(); ++k) {
+        shiftX[k] = static_cast<float>(stencil[k].dx * grid.cellSize);
+        shiftY[k] = static_cast<float>(stencil[k].dy * grid.cellSize);
+    }
+    const size_t ownCell = stencil.size();   // Index of the zero shift
+
+    parallelFor(bandCount, threads, [&](size_t band) {
+        std::vector<size_t> ngrids;
+        // Compare instance s (at grid position p) with grid positions
+        // [first, last) of the cell at stencil entry k (ownCell for its own)
+        auto scan = [&](size_t p, size_t k, size_t first, size_t last) {
+            const InstanceId s = grid.cellInstances[p];
+            const float px = useFloat ? fx[p] - shiftX[k] : 0.0f;
+            const float py = useFloat ? fy[p] - shiftY[k] : 0.0f;
+            for (size_t block = first; block < last; block += distance_kernel::BLOCK) {
+                const size_t count = std::min(distance_kernel::BLOCK, last - block);
+                std::uint64_t mask;
+                if (useFloat) {
+                    std::uint64_t uncertain;
+                    mask = withinDistanceF(px, py, fx.data() + block, fy.data() + block, count, sureSq, maybeSq,
+                                           &uncertain);
+                    if (uncertain != 0) {
+                        mask |= uncertain & withinDistance(grid.cellX[p], grid.cellY[p], grid.cellX.data() + block,
+                                                           grid.cellY.data() + block, count, distSq);
+                    }
+                } else {
+                    mask = withinDistance(grid.cellX[p], grid.cellY[p], grid.cellX.data() + block,
+                                          grid.cellY.data() + block, count, distSq);
+                }
+                while (mask != 0) {
+                    const InstanceId s_prime = grid.cellInstances[block + distance_kernel::lowestBit(mask)];
+                    mask &= mask - 1;
+
+                    // Same feature: neither BN nor SN. Otherwise s' is a BN of
+                    // s and s an SN of s' (or the other way round).
+                    if (types[s] < types[s_prime]) visit(band, s, s_prime);
+                    else if (types[s_prime] < types[s]) visit(band, s_prime, s);
+                }
+            }
+        };
+
+        // Cells are sorted by x, so the candidates of p form a window
+        // [lo, hi) that only moves right as p does (plane sweep). q is outside
+        // the window when (x[q] - x[p])^2 > d^2 in the kernel's own
+        // arithmetic, which can never hold for a pair the kernel accepts.
+        // Against a column whose points are all within d along x nothing can
+        // be cut, so there (and in small cells) the whole cell is scanned.
+        const std::vector<double>& xs = grid.cellX;
+        auto beyond = [&](double xp, double xq) {
+            const double dx = xq - xp;
+            return dx * dx > distSq;
+        };
+
+        for (size_t cellId = cells * band / bandCount; cellId < cells * (band + 1) / bandCount; ++cellId) {
+            const size_t ownFirst = grid.cellStart[cellId];
+            const size_t ownLast = grid.cellStart[cellId + 1];
+            if (ownFirst == ownLast) continue;
+
+            // Pairs inside the cell: only partners after p, up to the window end
+            size_t hi = ownFirst;
+            const bool sweepOwn = sweepOwnColumn && ownLast - ownFirst >= SWEEP_MIN_POINTS;
+            for (size_t p = ownFirst; p < ownLast; ++p) {
+                if (hi <= p) hi = p + 1;
+                if (!sweepOwn) hi = ownLast;
+                while (hi < ownLast && !beyond(xs[p], xs[hi])) ++hi;
+                scan(p, ownCell, p + 1, hi);
+            }
 
-    // 4. Assign each instance to the corresponding grid cell.
-    for (const auto& inst : instances) {
-        size_t gridX = static_cast<size_t>((inst.x - min_x) / distanceThreshold);
-        size_t gridY = static_cast<size_t>((inst.y - min_y) / distanceThreshold);
+            getForwardNeighborCells(cellId, grid, stencil, ngrids);
+            for (size_t k = 0; k < stencil.size(); ++k) {
+                if (ngrids[k] == SpatialGrid::NO_CELL) continue;
+                const size_t otherFirst = grid.cellStart[ngrids[k]];
+                const size_t otherLast = grid.cellStart[ngrids[k] + 1];
+                if (!sweepColumn[k] || otherLast - otherFirst < SWEEP_MIN_POINTS) {
+                    for (size_t p = ownFirst; p < ownLast; ++p) {
+                        scan(p, k, otherFirst, otherLast);
+                    }
+                    continue;
+                }
+                size_t lo = otherFirst;
+                hi = otherFirst;
+                for (size_t p = ownFirst; p < ownLast; ++p) {
+                    while (lo < otherLast && xs[lo] < xs[p] && beyond(xs[p], xs[lo])) ++lo;
+                    if (hi < lo) hi = lo;
+                    while (hi < otherLast && !(xs[hi] > xs[p] && beyond(xs[p], xs[hi]))) ++hi;
+                    scan(p, k, lo, hi);
+                }
+            }
+        }
+    });
+}
 
-        // Clamp indices to prevent out-of-bounds access (e.g., when val == max).
-        if (gridX >= gridCellsX) gridX = gridCellsX - 1;
-        if (gridY >= gridCellsY) gridY = gridCellsY - 1;
 
-        // Calculate linear index (row-major order) and store the instance pointer.
-        size_t gridID = gridY * gridCellsX + gridX;
-        dividedSpace[gridID].instances.push_back(&inst);
+template <typename Visit>
+void NeighborhoodMgr::joinIndex(const SpatialIndex& index, const InstanceStore& instances, double distanceThreshold,
+                                unsigned threads, size_t bandCount, Visit visit) const {
+    const size_t n = instances.size();
+    const std::vector<FeatureType>& types = instances.type;
+
+    parallelFor(bandCount, threads, [&](size_t band) {
+        std::vector<InstanceId> found;
+        for (size_t i = n * band / bandCount; i < n * (band + 1) / bandCount; ++i) {
+            const InstanceId s = static_cast<InstanceId>(i);
+            found.clear();
+            index.query(instances.x[s], instances.y[s], distanceThreshold, found);
+            // Each pair is found from both ends; keep it at the smaller id
+            for (InstanceId s_prime : found) {
+                if (s_prime <= s) continue;
+                if (types[s] < types[s_prime]) visit(band, s, s_prime);
+                else if (types[s_prime] < types[s]) visit(band, s_prime, s);
+            }
+        }
+    });
+}
+
+
+template <typename Join>
+void NeighborhoodMgr::buildGraph(size_t n, unsigned threads, size_t bandCount, size_t joinBytes, Join join) {
+    // A budget is checked against everything allocated here: the graph, plus
+    // the degree counters and the join's buffers while it is filled, or the
+    // radix scratch rows while it is sorted. Buffered mode would hold every
+    // edge before the size is known, so under a budget the graph is always
+    // built in two passes. The previous graph is released first.
+    graph = NeighborGraph();
+    const bool twoPass = mode == MaterializeMode::TwoPass || memoryBudget != 0;
+    const size_t sortTasks = std::max<size_t>(1, std::min<size_t>(n, 8 * size_t(threads)));
+    auto checkBudget = [&](size_t bytes) {
+        if (memoryBudget != 0 && bytes > memoryBudget) {
+            throw std::length_error("NeighborhoodMgr: neighbor graph needs " + std::to_string(bytes) +
+                                    " bytes, over the memory budget of " + std::to_string(memoryBudget));
+        }
+    };
+    // Counting holds two counters per instance, less than an empty graph and
+    // its fill-time counters: if those do not fit, nothing will
+    checkBudget(NeighborGraph::memoryBytesFor(n, 0) + n * sizeof(std::uint32_t) + joinBytes);
+
+    // Row sizes: several bands can touch the same instance, so the counters
+    // are atomic (no locks, and no per-thread copies of size n).
+    std::unique_ptr<std::atomic<std::uint32_t>[]> degree(new std::atomic<std::uint32_t>[n]());
+    std::unique_ptr<std::atomic<std::uint32_t>[]> sns(new std::atomic<std::uint32_t>[n]());
+    auto count = [&](InstanceId small, InstanceId big) {
+        degree[small].fetch_add(1, std::memory_order_relaxed);
+        degree[big].fetch_add(1, std::memory_order_relaxed);
+        sns[big].fetch_add(1, std::memory_order_relaxed);
+    };
+    // Both directions of an edge: degree[id] counts down to 0 and gives each
+    // writer its own slot in row id; the order within a row depends on
+    // scheduling until the rows are sorted below.
+    auto fill = [&](InstanceId small, InstanceId big) {
+        const std::uint32_t first = degree[small].fetch_sub(1, std::memory_order_relaxed) - 1;
+        graph.neighbors[graph.offsets[small] + first] = big;
+        const std::uint32_t second = degree[big].fetch_sub(1, std::memory_order_relaxed) - 1;
+        graph.neighbors[graph.offsets[big] + second] = small;
+    };
+    // Budget check from the counts alone, then the graph's arrays (the SN
+    // counts are copied out before their counters are freed)
+    auto allocate = [&]() {
+        size_t entries = 0, longest = 0;
+        for (size_t i = 0; i < n; ++i) {
+            const size_t length = degree[i].load(std::memory_order_relaxed);
+            entries += length;
+            longest = std::max(longest, length);
+        }
+        const size_t scratch =
+            longest >= RADIX_ROW_MIN ? std::min<size_t>(threads, sortTasks) * longest * sizeof(InstanceId) : 0;
+        checkBudget(NeighborGraph::memoryBytesFor(n, entries) +
+                    std::max(n * sizeof(std::uint32_t) + joinBytes, scratch));
+
+        graph.snCount.resize(n);
+        for (size_t i = 0; i < n; ++i) graph.snCount[i] = sns[i].load(std::memory_order_relaxed);
+        sns.reset();
+        graph.offsets.assign(n + 1, 0);
+        for (size_t i = 0; i < n; ++i) {
+            graph.offsets[i + 1] = graph.offsets[i] + degree[i].load(std::memory_order_relaxed);
+        }
+        graph.neighbors.assign(entries, 0);
+    };
+
+    if (twoPass) {
+        // Count, allocate exactly, then run the same join again to fill
+        join([&](size_t, InstanceId small, InstanceId big) { count(small, big); });
+        allocate();
+        join([&](size_t, InstanceId small, InstanceId big) { fill(small, big); });
+    } else {
+        // One join into per-band edge lists (a band writes only its own list),
+        // then count and scatter them
+        using Edge = std::pair<InstanceId, InstanceId>;
+        std::vector<std::vector<Edge>> edges(bandCount);
+        join([&](size_t band, InstanceId small, InstanceId big) { edges[band].emplace_back(small, big); });
+        parallelFor(bandCount, threads, [&](size_t band) {
+            for (const Edge& edge : edges[band]) count(edge.first, edge.second);
+        });
+        allocate();
+        parallelFor(bandCount, threads, [&](size_t band) {
+            for (const Edge& edge : edges[band]) fill(edge.first, edge.second);
+            std::vector<Edge>().swap(edges[band]);
+        });
     }
+    degree.reset();
+
+    // Sorted by id = sorted by feature first: SNs, then BNs. This also makes
+    // the result independent of the thread count.
+    // GetChildren() merges BN lists with sibling lists, so keep them in id order.
+    unsigned idBits = 1;
+    while (idBits < 32 && (InstanceId(1) << idBits) < n) ++idBits;
+    parallelFor(sortTasks, threads, [&](size_t task) {
+        const size_t first = n * task / sortTasks, last = n * (task + 1) / sortTasks;
+        // One scratch row as long as the task's longest, allocated once
+        size_t longest = 0;
+        for (size_t i = first; i < last; ++i) {
+            longest = std::max(longest, static_cast<size_t>(graph.offsets[i + 1] - graph.offsets[i]));
+        }
+        std::vector<InstanceId> scratch;
+        if (longest >= RADIX_ROW_MIN) scratch.reserve(longest);
+        for (size_t i = first; i < last; ++i) {
+            sortRow(graph.neighbors.data() + graph.offsets[i],
+                    static_cast<size_t>(graph.offsets[i + 1] - graph.offsets[i]), idBits, scratch);
+        }
+    });
+};
 
-    return dividedSpace;
+
+void NeighborhoodMgr::materialize(const InstanceStore& instances, const double& distanceThreshold) {
+    requireFeatureMajor(instances, "materialize()");
+    const std::string cachePath = cacheFile(instances, distanceThreshold);
+    if (loadCached(cachePath, instances.size())) return;
+    if (indexKind == SpatialIndexKind::Grid) {
+        materializeOnGrid(instances, divideSpace(distanceThreshold, instances), distanceThreshold);
+    } else {
+        materializeOnIndex(instances, *SpatialIndex::build(indexKind, instances, distanceThreshold), distanceThreshold);
+    }
+    if (!cachePath.empty()) graph.save(cachePath);
 };
 
 
-std::vector<Grid*> NeighborhoodMgr::getNeighborGrids(Grid& g, std::vector<Grid>& all_grids) const {
-    std::vector<Grid*> neighbor_grids;
-    neighbor_grids.reserve(9);
+void NeighborhoodMgr::materialize(const InstanceStore& instances, const SpatialGrid& grid, const double& distanceThreshold) {
+    requireFeatureMajor(instances, "materialize()");
+    const std::string cachePath = cacheFile(instances, distanceThreshold);
+    if (loadCached(cachePath, instances.size())) return;
+    materializeOnGrid(instances, grid, distanceThreshold);
+    if (!cachePath.empty()) graph.save(cachePath);
+}
 
-	// 1. Get grid dimensions
-    long long width = static_cast<long long>(this->gridCellsX);
-    long long height = static_cast<long long>(this->gridCellsY);
 
-	// 2. Calculate current grid's 2D coordinates
-    long long curX = g.grid_id % width;
-    long long curY = g.grid_id / width;
+void NeighborhoodMgr::materialize(const InstanceStore& instances, const SpatialIndex& index,
+                                  const double& distanceThreshold) {
+    requireFeatureMajor(instances, "materialize()");
+    const std::string cachePath = cacheFile(instances, distanceThreshold);
+    if (loadCached(cachePath, instances.size())) return;
+    if (index.kind() == SpatialIndexKind::Grid) {
+        materializeOnGrid(instances, static_cast<const GridIndex&>(index).grid(), distanceThreshold);
+    } else {
+        materializeOnIndex(instances, index, distanceThreshold);
+    }
+    if (!cachePath.empty()) graph.save(cachePath);
+}
 
-    for (int dy = -1; dy <= 1; ++dy) {
-        for (int dx = -1; dx <= 1; ++dx) {
-			// Calculate neighbor coordinates
-            long long nx = curX + dx;
-            long long ny = curY + dy;
 
-			// 3. CHECK LOGIC: Check bounds
-            if (nx >= 0 && nx < width &&
-                ny >= 0 && ny < height) {
+void NeighborhoodMgr::materializeOnGrid(const InstanceStore& instances, const SpatialGrid& grid,
+                                        double distanceThreshold) {
+    if (!grid.empty() && grid.reach < distanceThreshold) {
+        throw std::invalid_argument("NeighborhoodMgr: grid stencil is shorter than the neighbor distance");
+    }
+    if (grid.empty() && !instances.empty()) {
+        throw std::invalid_argument("NeighborhoodMgr: grid does not cover the instances");
+    }
 
-				// 4. Calculate neighbor grid ID
-                size_t nid = ny * width + nx;
+    // The stored cells are cut into bands of consecutive cells, several per
+    // thread so that dense and sparse bands even out
+    const unsigned threads = resolveThreadCount(threadCount);
+    const size_t bandCount = std::max<size_t>(1, std::min<size_t>(grid.cellCount(), 8 * size_t(threads)));
+    // Float mode keeps two float offsets per instance during each join
+    const size_t joinBytes = precision == CoordinatePrecision::Float ? instances.size() * 2 * sizeof(float) : 0;
+    buildGraph(instances.size(), threads, bandCount, joinBytes, [&](auto visit) {
+        joinGrid(grid, instances, distanceThreshold, threads, bandCount, visit);
+    });
+};
 
-				// Add neighbor grid pointer to the list
-                neighbor_grids.push_back(&all_grids[nid]);
-            }
-        }
+
+void NeighborhoodMgr::materializeOnIndex(const InstanceStore& instances, const SpatialIndex& index,
+                                         double distanceThreshold) {
+    // Bands of consecutive ids: neighbors in space are mostly neighbors in id
+    // within a feature (Hilbert order), so a band's queries share tree paths
+    const unsigned threads = resolveThreadCount(threadCount);
+    const size_t bandCount = std::max<size_t>(1, std::min<size_t>(instances.size(), 8 * size_t(threads)));
+    buildGraph(instances.size(), threads, bandCount, 0, [&](auto visit) {
+        joinIndex(index, instances, distanceThreshold, threads, bandCount, visit);
+    });
+}
+
+
+std::string NeighborhoodMgr::cacheFile(const InstanceStore& instances, double distanceThreshold) const {
+    if (cacheDirectory.empty()) return std::string();
+    std::uint64_t distanceBits;
+    std::memcpy(&distanceBits, &distanceThreshold, sizeof(distanceBits));
+    char name[64];
+    std::snprintf(name, sizeof(name), "neighbors_%016llx_%016llx.csr",
+                  static_cast<unsigned long long>(instances.contentHash()),
+                  static_cast<unsigned long long>(distanceBits));
+    std::filesystem::create_directories(cacheDirectory);
+    return (std::filesystem::path(cacheDirectory) / name).string();
+}
+
+
+bool NeighborhoodMgr::loadCached(const std::string& path, size_t instanceCount) {
+    cacheHit = false;
+    std::error_code error;
+    if (path.empty() || !std::filesystem::is_regular_file(path, error)) return false;
+
+    // The file is the graph's arrays plus a header: check the budget before
+    // reading it, as materialize() would before allocating
+    const std::uintmax_t bytes = std::filesystem::file_size(path, error);
+    if (!error && memoryBudget != 0 && bytes > memoryBudget) {
+        throw std::length_error("NeighborhoodMgr: cached neighbor graph '" + path + "' has " + std::to_string(bytes) +
+                                " bytes, over the memory budget of " + std::to_string(memoryBudget));
     }
-    return neighbor_grids;
+    try {
+        NeighborGraph cached = NeighborGraph::load(path);
+        if (cached.size() != instanceCount) return false;
+        graph = std::move(cached);
+    } catch (const std::runtime_error&) {
+        return false;   // Corrupt or from another format version: rebuilt and overwritten
+    }
+    cacheHit = true;
+    return true;
+}
+
+
+void NeighborhoodMgr::setCacheDirectory(std::string directory) {
+    cacheDirectory = std::move(directory);
+}
+
+
+void NeighborhoodMgr::setThreadCount(unsigned threads) {
+    threadCount = threads;
 }
 
 
-bool NeighborhoodMgr::isNeighbor(const SpatialInstance* s, const SpatialInstance* s_prime, double distanceThreshold) const {
-    double dx = s->x - s_prime->x;
-    double dy = s->y - s_prime->y;
-    double dist_sq = dx * dx + dy * dy;
-	return dist_sq <= (distanceThreshold * distanceThreshold);
+void NeighborhoodMgr::setSpatialIndex(SpatialIndexKind kind) {
+    indexKind = kind;
+}
+
+
+void NeighborhoodMgr::setMaterializeMode(MaterializeMode materializeMode) {
+    mode = materializeMode;
+}
+
+
+void NeighborhoodMgr::setMemoryBudget(size_t bytes) {
+    memoryBudget = bytes;
+}
+
+
+void NeighborhoodMgr::setCoordinatePrecision(CoordinatePrecision coordinatePrecision) {
+    precision = coordinatePrecision;
+}
+
+
+const NeighborGraph& NeighborhoodMgr::getAllNeighbors() const {
+	return this->graph;
 };
 
 
-void NeighborhoodMgr::materialize(const std::vector<SpatialInstance>& instances, const double& distanceThreshold) {
-    allNeighbors.clear();
-
-	std::vector<Grid> grids = divideSpace(distanceThreshold, instances);
-    for (auto& grid : grids) {
-        std::vector<Grid*> ngrids = getNeighborGrids(grid, grids);
-        for (const auto* s : grid.instances) {
-            for (const auto* ngrid : ngrids) {
-                for (const auto* s_prime : ngrid->instances) {
-                    if (s == s_prime) continue;  // Skip self-comparison
-                    if (isNeighbor(s, s_prime, distanceThreshold)) {
-                        if (s->type < s_prime->type) {
-                            this->allNeighbors[s].addBN(s_prime);
-                        } else if (s->type > s_prime->type) {
-                            this->allNeighbors[s].addSN(s_prime);
+void NeighborhoodMgr::setGraph(NeighborGraph neighbors) {
+    graph = std::move(neighbors);
+}
+
+
+NeighborUpdate NeighborhoodMgr::update(InstanceStore& instances, const std::vector<InstanceId>& removed,
+                                       const InstanceStore& added, double distanceThreshold) {
+    const size_t n = instances.size();
+    const size_t m = added.size();
+    requireFeatureMajor(instances, "update()");
+    if (graph.size() != n) {
+        throw std::logic_error("NeighborhoodMgr: update() needs the graph of these instances (materialize first)");
+    }
+    cacheHit = false;
+
+    std::vector<char> gone(n, 0);
+    for (InstanceId id : removed) {
+        if (id >= n) throw std::out_of_range("NeighborhoodMgr: removed id " + std::to_string(id) + " does not exist");
+        gone[id] = 1;
+    }
+    const size_t goneCount = static_cast<size_t>(std::count(gone.begin(), gone.end(), 1));
+    const size_t newN = n - goneCount + m;
+    if (newN >= INVALID_INSTANCE) throw std::length_error("NeighborhoodMgr: too many instances for 32-bit ids");
+
+    // Feature codes after the update: new names are interned, then every code
+    // is renumbered in name order like after a load. codeOf[old code] is the
+    // new code of an existing feature.
+    FeatureDictionary features = instances.features;
+    std::vector<FeatureType> addedType(m);
+    std::vector<FeatureType> codeOf;
+    {
+        std::vector<FeatureType> addedCode(added.features.size());
+        for (size_t c = 0; c < addedCode.size(); ++c) {
+            addedCode[c] = features.intern(added.features.name(static_cast<FeatureType>(c)));
+        }
+        const std::vector<FeatureType> remap = features.finalize();
+        codeOf.assign(remap.begin(), remap.begin() + instances.features.size());
+        for (size_t j = 0; j < m; ++j) addedType[j] = remap[addedCode[added.type[j]]];
+    }
+    // Existing features keep their relative order unless their codes were not
+    // in name order before; only then can remaining ids move past each other
+    const bool sortedRemap = std::is_sorted(codeOf.begin(), codeOf.end());
+
+    // New ids, feature by feature: the remaining instances in their old order,
+    // then the added ones. With sortedRemap, old ids map in increasing order.
+    std::vector<size_t> next(features.size() + 1, 0);
+    for (size_t i = 0; i < n; ++i) next[codeOf[instances.type[i]] + 1] += !gone[i];
+    for (size_t j = 0; j < m; ++j) ++next[addedType[j] + 1];
+    for (size_t t = 1; t < next.size(); ++t) next[t] += next[t - 1];
+
+    NeighborUpdate result;
+    result.remap.assign(n, INVALID_INSTANCE);
+    result.inserted.resize(m);
+    std::vector<InstanceId> origin(newN);   // Old id, or n + j for added[j]
+    for (size_t i = 0; i < n; ++i) {
+        if (gone[i]) continue;
+        result.remap[i] = static_cast<InstanceId>(next[codeOf[instances.type[i]]]++);
+        origin[result.remap[i]] = static_cast<InstanceId>(i);
+    }
+    for (size_t j = 0; j < m; ++j) {
+        result.inserted[j] = static_cast<InstanceId>(next[addedType[j]]++);
+        origin[result.inserted[j]] = static_cast<InstanceId>(n + j);
+    }
+
+    // Rows of the added instances, the only distance tests of the update.
+    // Every instance probes the 3x3 cells around it in a grid over the added
+    // instances (cells a little wider than d, so that rounding cannot put a
+    // pair within d two cells apart). A bitmap of the cells next to an added
+    // instance turns most remaining instances away with one bit test.
+    const unsigned threads = resolveThreadCount(threadCount);
+    std::vector<std::vector<InstanceId>> addedRows(m);
+    if (m > 0) {
+        const distance_kernel::BlockFn withinDistance = distance_kernel::select();
+        const SpatialGrid addedGrid = SpatialGrid::build(added, distanceThreshold * (1.0 + 1.0 / (1 << 20)),
+                                                         GridLayout::Sparse, 1);
+        const double distSq = distanceThreshold * distanceThreshold;
+
+        // Bit (cx + 1) + (cy + 1) * maskWidth: the extent grown by one cell on
+        // each side (no bitmap if that is over NEAR_MASK_BITS)
+        constexpr std::uint64_t NEAR_MASK_BITS = std::uint64_t(1) << 28;
+        const std::uint64_t maskWidth = addedGrid.cellsX + 2, maskHeight = addedGrid.cellsY + 2;
+        std::vector<std::uint64_t> nearMask;
+        if (maskWidth <= NEAR_MASK_BITS / maskHeight) {
+            nearMask.assign((maskWidth * maskHeight + 63) / 64, 0);
+            for (size_t c = 0; c < addedGrid.cellCount(); ++c) {
+                const CellCoord coord = addedGrid.coordOf(c);
+                for (std::uint64_t y = coord.cy; y <= coord.cy + 2; ++y) {
+                    for (std::uint64_t x = coord.cx; x <= coord.cx + 2; ++x) {
+                        const std::uint64_t bit = x + y * maskWidth;
+                        nearMask[bit / 64] |= std::uint64_t(1) << (bit % 64);
+                    }
+                }
+            }
+        }
+
+        auto probe = [&](double x, double y, auto&& found) {
+            const double fx = std::floor((x - addedGrid.minX) / addedGrid.cellSize);
+            const double fy = std::floor((y - addedGrid.minY) / addedGrid.cellSize);
+            const double lastX = static_cast<double>(addedGrid.cellsX), lastY = static_cast<double>(addedGrid.cellsY);
+            if (!(fx >= -1.0 && fx <= lastX && fy >= -1.0 && fy <= lastY)) return;
+            if (!nearMask.empty()) {
+                const std::uint64_t bit = static_cast<std::uint64_t>(fx + 1.0) + static_cast<std::uint64_t>(fy + 1.0) * maskWidth;
+                if ((nearMask[bit / 64] >> (bit % 64) & 1) == 0) return;
+            }
+            for (double cy = fy - 1.0; cy <= fy + 1.0; ++cy) {
+                for (double cx = fx - 1.0; cx <= fx + 1.0; ++cx) {
+                    if (cx < 0.0 || cy < 0.0 || cx >= lastX || cy >= lastY) continue;
+                    const size_t c = addedGrid.findCell({ static_cast<std::uint64_t>(cx), static_cast<std::uint64_t>(cy) });
+                    if (c == SpatialGrid::NO_CELL) continue;
+                    const size_t first = addedGrid.cellStart[c], count = addedGrid.cellStart[c + 1] - first;
+                    for (size_t block = 0; block < count; block += distance_kernel::BLOCK) {
+                        std::uint64_t mask = withinDistance(x, y, addedGrid.cellX.data() + first + block,
+                                                            addedGrid.cellY.data() + first + block,
+                                                            std::min(distance_kernel::BLOCK, count - block), distSq);
+                        for (; mask != 0; mask &= mask - 1) {
+                            found(addedGrid.cellInstances[first + block + distance_kernel::lowestBit(mask)]);
                         }
                     }
-				}
+                }
+            }
+        };
+
+        // Remaining instances, in bands; each band collects its own pairs
+        using Pair = std::pair<InstanceId, InstanceId>;   // Added index, new id of the remaining instance
+        const size_t bands = std::max<size_t>(1, std::min<size_t>(n, 8 * size_t(threads)));
+        std::vector<std::vector<Pair>> pairs(bands);
+        parallelFor(bands, threads, [&](size_t band) {
+            for (size_t i = n * band / bands; i < n * (band + 1) / bands; ++i) {
+                if (gone[i]) continue;
+                probe(instances.x[i], instances.y[i], [&](InstanceId j) {
+                    if (addedType[j] != codeOf[instances.type[i]]) pairs[band].emplace_back(j, result.remap[i]);
+                });
             }
+        });
+        for (const std::vector<Pair>& band : pairs) {
+            for (const Pair& pair : band) addedRows[pair.first].push_back(pair.second);
+        }
+        parallelFor(m, threads, [&](size_t j) {
+            probe(added.x[j], added.y[j], [&](InstanceId k) {
+                if (addedType[k] != addedType[j]) addedRows[j].push_back(result.inserted[k]);
+            });
+            std::sort(addedRows[j].begin(), addedRows[j].end());
+        });
+    }
 
+    // The same pairs seen from the remaining instances, as small sorted lists
+    std::vector<std::uint64_t> gainStart(newN + 1, 0);
+    for (size_t j = 0; j < m; ++j) {
+        for (InstanceId other : addedRows[j]) {
+            if (origin[other] < n) ++gainStart[other + 1];
         }
-	}
-};
+    }
+    for (size_t i = 0; i < newN; ++i) gainStart[i + 1] += gainStart[i];
+    std::vector<InstanceId> gains(gainStart[newN]);
+    {
+        std::vector<std::uint64_t> fill(gainStart.begin(), gainStart.end() - 1);
+        for (size_t j = 0; j < m; ++j) {
+            for (InstanceId other : addedRows[j]) {
+                if (origin[other] < n) gains[fill[other]++] = result.inserted[j];
+            }
+        }
+    }
 
+    // Remaining instances next to a removed one (old ids): only their rows
+    // need a look at every entry
+    std::vector<char> lost(n, 0);
+    for (size_t i = 0; i < n; ++i) {
+        if (!gone[i]) continue;
+        for (InstanceId other : graph.neighborsOf(static_cast<InstanceId>(i))) lost[other] = 1;
+    }
 
-const std::unordered_map<const SpatialInstance*, NeighborList>& NeighborhoodMgr::getAllNeighbors() const {
-	return this->allNeighbors;
-};
+    // Count, allocate, fill. Remaining rows are the old row with the removed
+    // ids dropped and renumbered (still sorted if sortedRemap), merged with
+    // their gains.
+    constexpr size_t ROWS_PER_TASK = 4096;
+    const size_t tasks = (newN + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+    NeighborGraph patched;
+    patched.offsets.assign(newN + 1, 0);
+    patched.snCount.resize(newN);
+    std::vector<char> changed(newN, 0);
+    parallelFor(tasks, threads, [&](size_t task) {
+        for (size_t id = task * ROWS_PER_TASK; id < std::min(newN, (task + 1) * ROWS_PER_TASK); ++id) {
+            if (origin[id] >= n) {
+                patched.offsets[id + 1] = addedRows[origin[id] - n].size();
+                changed[id] = 1;
+                continue;
+            }
+            const std::uint64_t gained = gainStart[id + 1] - gainStart[id];
+            const InstanceSpan row = graph.neighborsOf(origin[id]);
+            std::uint64_t kept = row.size();
+            if (lost[origin[id]]) {
+                for (InstanceId other : row) kept -= gone[other];
+            }
+            patched.offsets[id + 1] = kept + gained;
+            changed[id] = gained != 0 || lost[origin[id]];
+        }
+    });
+    for (size_t id = 0; id < newN; ++id) patched.offsets[id + 1] += patched.offsets[id];
+
+    const size_t bytes = NeighborGraph::memoryBytesFor(newN, static_cast<size_t>(patched.offsets[newN]));
+    if (memoryBudget != 0 && bytes > memoryBudget) {
+        throw std::length_error("NeighborhoodMgr: neighbor graph needs " + std::to_string(bytes) +
+                                " bytes, over the memory budget of " + std::to_string(memoryBudget));
+    }
+    patched.neighbors.resize(patched.offsets[newN]);
+    parallelFor(tasks, threads, [&](size_t task) {
+        for (size_t id = task * ROWS_PER_TASK; id < std::min(newN, (task + 1) * ROWS_PER_TASK); ++id) {
+            InstanceId* out = patched.neighbors.data() + patched.offsets[id];
+            if (origin[id] >= n) {
+                std::copy(addedRows[origin[id] - n].begin(), addedRows[origin[id] - n].end(), out);
+            } else {
+                InstanceId* gain = gains.data() + gainStart[id];
+                InstanceId* gainEnd = gains.data() + gainStart[id + 1];
+                std::sort(gain, gainEnd);
+                for (InstanceId other : graph.neighborsOf(origin[id])) {
+                    if (gone[other]) continue;
+                    const InstanceId mapped = result.remap[other];
+                    while (gain != gainEnd && *gain < mapped) *out++ = *gain++;
+                    *out++ = mapped;
+                }
+                std::copy(gain, gainEnd, out);
+                if (!sortedRemap) {
+                    std::sort(patched.neighbors.data() + patched.offsets[id],
+                              patched.neighbors.data() + patched.offsets[id + 1]);
+                }
+            }
+            // No neighbor shares the feature, so the SNs are the ids below this one
+            InstanceId* first = patched.neighbors.data() + patched.offsets[id];
+            patched.snCount[id] = static_cast<std::uint32_t>(
+                std::lower_bound(first, patched.neighbors.data() + patched.offsets[id + 1], InstanceId(id)) - first);
+        }
+    });
+
+    // Rewrite the store in the new order
+    InstanceStore updated;
+    updated.features = std::move(features);
+    updated.reserve(newN);
+    for (InstanceId source : origin) {
+        if (source < n) {
+            updated.push_back(codeOf[instances.type[source]], instances.origId[source], instances.x[source],
+                              instances.y[source]);
+        } else {
+            const size_t j = source - n;
+            updated.push_back(addedType[j], added.origId[j], added.x[j], added.y[j]);
+        }
+    }
+    // Feature-major, which is what the graph and IDS rely on. Not in
+    // sortSpatially() order: added instances sit at the end of their feature,
+    // and the curve follows the bounds, which may have moved
+    updated.featureMajor = true;
+
+    for (size_t id = 0; id < newN; ++id) {
+        if (changed[id]) result.changed.push_back(static_cast<InstanceId>(id));
+    }
+    instances = std::move(updated);
+    graph = std::move(patched);
+    return result;
+}
+
+
+NeighborGraph NeighborhoodMgr::takeGraph() {
+    NeighborGraph taken = std::move(graph);
+    graph.clear();
+    return taken;
+}
 
 
-void NeighborhoodMgr::printResults() const {
+void NeighborhoodMgr::printResults(const InstanceStore& instances) const {
     std::cout << "\n--- KET QUA NEIGHBORHOOD ---" << std::endl;
-    for (const auto& pair : allNeighbors) {
-        const SpatialInstance* s = pair.first;
-        const NeighborList& nl = pair.second;
+    for (InstanceId id = 0; id < graph.size(); ++id) {
+        if (graph.neighborsOf(id).empty()) continue;
+        const InstanceSpan bns = graph.bigNeighbors(id);
+        const InstanceSpan sns = graph.smallNeighbors(id);
 
-        std::cout << "ID: " << s->id << " | Type: " << s->type
-            << " | Pos: (" << s->x << ", " << s->y << ")\n";
+        std::cout << "ID: " << instances.label(id) << " | Type: " << instances.features.name(instances.type[id])
+            << " | Pos: (" << instances.x[id] << ", " << instances.y[id] << ")\n";
 
         std::cout << "  -> BN (>=): ";
-        if (nl.BNs.empty()) std::cout << "None";
-        for (const auto* n : nl.BNs) std::cout << n->id << " ";
+        if (bns.empty()) std::cout << "None";
+        for (InstanceId n : bns) std::cout << instances.label(n) << " ";
         std::cout << "\n";
 
         std::cout << "  -> SN (<):  ";
-        if (nl.SNs.empty()) std::cout << "None";
-        for (const auto* n : nl.SNs) std::cout << n->id << " ";
+        if (sns.empty()) std::cout << "None";
+        for (InstanceId n : sns) std::cout << instances.label(n) << " ";
         std::cout << "\n";
     }
 }
 
-std::vector<InstanceId> NeighborhoodMgr::getBigNeighbors(const InstanceId& id) const {
-    const SpatialInstance* key = nullptr;
-    // Linear search for the instance string ID
-    for (const auto& pair : allNeighbors) {
-        if (pair.first->id == id) {
-            key = pair.first;
-            break;
-        }
-    }
-
-    if (!key) return {};
-
-    const auto& bns = allNeighbors.at(key).BNs;
-    std::vector<InstanceId> res;
-    res.reserve(bns.size());
-    for (const auto* n : bns) {
-        res.push_back(n->id);
-    }
-    return res;
+InstanceSpan NeighborhoodMgr::getBigNeighbors(InstanceId id) const {
+    if (id >= graph.size()) return {};
+    return graph.bigNeighbors(id);
 }
\ No newline at end of file
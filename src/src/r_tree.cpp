@@ -0,0 +1,117 @@
+/**
+ * @file r_tree.cpp
+ * @brief Implementation of the STR-packed R-tree
+ */
+
+#include "r_tree.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Sort-Tile-Recursive order of `items` for packing runs of `capacity`: by x,
+// then each vertical slice of sqrt(groups) runs by y. Ties fall back to the
+// item value so that the layout is deterministic.
+template <typename CenterX, typename CenterY>
+void strOrder(std::vector<std::uint32_t>& items, size_t capacity, CenterX centerX, CenterY centerY) {
+    std::sort(items.begin(), items.end(), [&](std::uint32_t a, std::uint32_t b) {
+        return centerX(a) < centerX(b) || (centerX(a) == centerX(b) && a < b);
+    });
+    const size_t groups = (items.size() + capacity - 1) / capacity;
+    const size_t slices = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(groups))));
+    const size_t sliceSize = slices * capacity;
+    for (size_t first = 0; first < items.size(); first += sliceSize) {
+        const size_t last = std::min(items.size(), first + sliceSize);
+        std::sort(items.begin() + first, items.begin() + last, [&](std::uint32_t a, std::uint32_t b) {
+            return centerY(a) < centerY(b) || (centerY(a) == centerY(b) && a < b);
+        });
+    }
+}
+
+} // namespace
+
+RTree::RTree(const InstanceStore& instances) {
+    if (instances.empty()) return;
+
+    // Leaves: STR over the points themselves
+    const size_t n = instances.size();
+    ids.resize(n);
+    for (InstanceId id = 0; id < n; ++id) ids[id] = id;
+    strOrder(ids, LEAF_CAPACITY,
+             [&](InstanceId id) { return instances.x[id]; },
+             [&](InstanceId id) { return instances.y[id]; });
+
+    xs.resize(n);
+    ys.resize(n);
+    std::vector<Node> level;
+    for (size_t first = 0; first < n; first += LEAF_CAPACITY) {
+        const size_t last = std::min(n, first + LEAF_CAPACITY);
+        BoundingBox box = BoundingBox::none();
+        for (size_t i = first; i < last; ++i) {
+            xs[i] = instances.x[ids[i]];
+            ys[i] = instances.y[ids[i]];
+            box.include(xs[i], ys[i]);
+        }
+        level.push_back({ box, static_cast<std::uint32_t>(first), static_cast<std::uint32_t>(last) });
+    }
+    leafCount = level.size();
+
+    // Upper levels: STR over the node centers of the level below, which is
+    // appended to `nodes` in that order so that siblings are contiguous
+    std::vector<std::uint32_t> order;
+    while (true) {
+        if (level.size() == 1) {
+            nodes.push_back(level.front());
+            break;
+        }
+        order.resize(level.size());
+        for (size_t i = 0; i < level.size(); ++i) order[i] = static_cast<std::uint32_t>(i);
+        strOrder(order, NODE_CAPACITY,
+                 [&](std::uint32_t i) { return level[i].box.minX + level[i].box.maxX; },
+                 [&](std::uint32_t i) { return level[i].box.minY + level[i].box.maxY; });
+
+        const size_t levelStart = nodes.size();
+        for (std::uint32_t i : order) nodes.push_back(level[i]);
+
+        std::vector<Node> parents;
+        for (size_t first = 0; first < order.size(); first += NODE_CAPACITY) {
+            const size_t last = std::min(order.size(), first + NODE_CAPACITY);
+            BoundingBox box = BoundingBox::none();
+            for (size_t i = first; i < last; ++i) box.include(nodes[levelStart + i].box);
+            parents.push_back({ box, static_cast<std::uint32_t>(levelStart + first),
+                                static_cast<std::uint32_t>(levelStart + last) });
+        }
+        level.swap(parents);
+    }
+}
+
+void RTree::query(double x, double y, double radius, std::vector<InstanceId>& out) const {
+    if (nodes.empty()) return;
+    const double r2 = radius * radius;
+
+    // At most NODE_CAPACITY - 1 pending siblings per level, and a tree over
+    // 2^32 points has fewer than 10 levels
+    std::uint32_t stack[256];
+    size_t top = 0;
+    stack[top++] = static_cast<std::uint32_t>(nodes.size() - 1);
+    while (top > 0) {
+        const std::uint32_t index = stack[--top];
+        const Node& node = nodes[index];
+        if (boxBeyond(node.box, x, y, r2)) continue;
+        if (index < leafCount) {
+            if (boxWithin(node.box, x, y, r2)) {
+                out.insert(out.end(), ids.begin() + node.first, ids.begin() + node.last);
+            } else {
+                appendWithin(x, y, ids.data() + node.first, xs.data() + node.first, ys.data() + node.first,
+                             node.last - node.first, r2, out);
+            }
+            continue;
+        }
+        for (std::uint32_t child = node.first; child < node.last; ++child) stack[top++] = child;
+    }
+}
+
+size_t RTree::memoryBytes() const {
+    return nodes.capacity() * sizeof(Node) + ids.capacity() * sizeof(InstanceId) +
+           (xs.capacity() + ys.capacity()) * sizeof(double);
+}
@@ -0,0 +1,307 @@
+/**
+ * @file snapshot.cpp
+ * @brief Writing and loading of binary columnar dataset snapshots (.cbin),
+ *        the gridded load that bins snapshot rows while copying them, and
+ *        in-place row access (SnapshotRows)
+ */
+
+#include "data_loader.h"
+#include "cbin_format.h"
+#include "mapped_file.h"
+#include "snapshot_rows.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+std::runtime_error snapshotError(const std::string& filepath, const std::string& what) {
+    return std::runtime_error("DataLoader: snapshot '" + filepath + "': " + what);
+}
+
+// Write zero bytes up to `target` so that the next section starts aligned
+void padTo(std::ofstream& out, std::uint64_t& offset, std::uint64_t target) {
+    static const char zeros[cbin::COLUMN_ALIGN] = {};
+    out.write(zeros, static_cast<std::streamsize>(target - offset));
+    offset = target;
+}
+
+template <typename T>
+void writeColumn(std::ofstream& out, std::uint64_t& offset, const std::vector<T>& column) {
+    out.write(reinterpret_cast<const char*>(column.data()), static_cast<std::streamsize>(column.size() * sizeof(T)));
+    offset += column.size() * sizeof(T);
+}
+
+template <typename T>
+void readColumn(const MappedFile& file, std::uint64_t offset, std::uint64_t count, std::vector<T>& column) {
+    column.resize(count);
+    std::memcpy(column.data(), file.data() + offset, count * sizeof(T));
+}
+
+/**
+ * @brief Apply the row filters of `options` to a fully read store, in place
+ *
+ * Kept rows keep their relative order. Features left without rows are removed
+ * from the dictionary, as if their rows had never been read; the remaining codes
+ * keep their relative order, so a feature-major layout stays valid.
+ */
+void dropFilteredRows(InstanceStore& instances, const LoadOptions& options) {
+    const FeatureDictionary& features = instances.features;
+    std::vector<char> featureKept(features.size());
+    for (FeatureType code = 0; code < features.size(); ++code) {
+        featureKept[code] = options.keepsFeature(features.name(code));
+    }
+
+    std::vector<size_t> rowsPerCode(features.size(), 0);
+    instances.bounds = BoundingBox::none();
+    size_t n = 0;
+    for (size_t i = 0; i < instances.size(); ++i) {
+        if (!featureKept[instances.type[i]] || !options.keepsPoint(instances.x[i], instances.y[i])) continue;
+        instances.x[n] = instances.x[i];
+        instances.y[n] = instances.y[i];
+        instances.type[n] = instances.type[i];
+        instances.origId[n] = instances.origId[i];
+        instances.bounds.include(instances.x[i], instances.y[i]);
+        ++rowsPerCode[instances.type[i]];
+        ++n;
+    }
+    instances.x.resize(n);
+    instances.y.resize(n);
+    instances.type.resize(n);
+    instances.origId.resize(n);
+    instances.x.shrink_to_fit();
+    instances.y.shrink_to_fit();
+    instances.type.shrink_to_fit();
+    instances.origId.shrink_to_fit();
+
+    // Names are interned in code (= name) order, so finalize() keeps them in place
+    FeatureDictionary kept;
+    std::vector<FeatureType> recode(features.size(), 0);
+    for (FeatureType code = 0; code < features.size(); ++code) {
+        if (rowsPerCode[code] > 0) recode[code] = kept.intern(features.name(code));
+    }
+    kept.finalize();
+    for (auto& type : instances.type) {
+        type = recode[type];
+    }
+    instances.features = std::move(kept);
+}
+
+/**
+ * @brief Check the header and section table of a mapped snapshot and read its
+ *        dictionary into `features` (finalized)
+ * @return The finalize() remapping of the stored codes (normally the identity)
+ */
+std::vector<FeatureType> readHeader(const MappedFile& file, const std::string& filepath, cbin::Header& header,
+                                    FeatureDictionary& features) {
+    if (file.size() < sizeof(cbin::Header)) throw snapshotError(filepath, "file too small");
+
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, cbin::MAGIC, sizeof(header.magic)) != 0) {
+        throw snapshotError(filepath, "not a .cbin file");
+    }
+    if (header.byteOrder != cbin::BYTE_ORDER_MARK) {
+        throw snapshotError(filepath, "written on a machine with a different byte order");
+    }
+    if (header.version != cbin::VERSION) {
+        throw snapshotError(filepath, "unsupported version " + std::to_string(header.version) +
+                                      " (expected " + std::to_string(cbin::VERSION) + ")");
+    }
+
+    // Every section must lie inside the file
+    const std::uint64_t fileSize = file.size();
+    auto inside = [&](std::uint64_t offset, std::uint64_t bytes) {
+        return offset <= fileSize && bytes <= fileSize - offset;
+    };
+    const std::uint64_t count = header.count;
+    if (count > fileSize || !inside(header.dictOffset, header.dictBytes) ||
+        !inside(header.xOffset, count * sizeof(double)) ||
+        !inside(header.yOffset, count * sizeof(double)) ||
+        !inside(header.typeOffset, count * sizeof(FeatureType)) ||
+        !inside(header.origIdOffset, count * sizeof(std::int32_t))) {
+        throw snapshotError(filepath, "truncated or corrupt section table");
+    }
+
+    const char* p = file.data() + header.dictOffset;
+    const char* dictEnd = p + header.dictBytes;
+    for (std::uint32_t i = 0; i < header.featureCount; ++i) {
+        std::uint32_t length;
+        if (static_cast<size_t>(dictEnd - p) < sizeof(length)) throw snapshotError(filepath, "corrupt dictionary");
+        std::memcpy(&length, p, sizeof(length));
+        p += sizeof(length);
+        if (static_cast<size_t>(dictEnd - p) < length) throw snapshotError(filepath, "corrupt dictionary");
+        if (features.intern(std::string_view(p, length)) != i) {
+            throw snapshotError(filepath, "duplicate feature name in dictionary");
+        }
+        p += length;
+    }
+    // Snapshots store finalized codes, so this is normally the identity
+    return features.finalize();
+}
+
+// Either flag means the row order is the one ids were handed out in (a
+// sortSpatially() order is feature-major too): it is kept if the codes did
+// not move
+bool isFinalOrder(const cbin::Header& header, const std::vector<FeatureType>& remap) {
+    bool identity = true;
+    for (FeatureType code = 0; code < remap.size(); ++code) identity = identity && remap[code] == code;
+    return (header.flags & (cbin::FLAG_SPATIALLY_ORDERED | cbin::FLAG_FEATURE_MAJOR)) != 0 && identity;
+}
+
+/**
+ * @brief Shared body of load_snapshot() and the snapshot case of load_gridded()
+ *
+ * If `grid` is given it receives a grid for neighbor distance `distance`. When
+ * the stored rows are already final (spatially ordered, no filters) the cells
+ * are counted while the coordinate columns are copied, using the bounding box
+ * from the header, and filled right after; otherwise the grid is built from
+ * the finished store.
+ */
+InstanceStore readSnapshot(const std::string& filepath, const LoadOptions& options,
+                           SpatialGrid* grid, double distance) {
+    MappedFile file(filepath);
+    cbin::Header header;
+    InstanceStore instances;
+    const std::vector<FeatureType> remap = readHeader(file, filepath, header, instances.features);
+    const std::uint64_t count = header.count;
+
+    const bool finalOrder = isFinalOrder(header, remap);
+    const bool binWhileCopying = grid != nullptr && finalOrder && !options.filters() && count > 0;
+    if (binWhileCopying) {
+        *grid = SpatialGrid({ header.minX, header.minY, header.maxX, header.maxY }, distance, count);
+        instances.x.resize(count);
+        instances.y.resize(count);
+        const char* xs = file.data() + header.xOffset;
+        const char* ys = file.data() + header.yOffset;
+        for (size_t i = 0; i < count; ++i) {
+            double px, py;
+            std::memcpy(&px, xs + i * sizeof(double), sizeof(double));
+            std::memcpy(&py, ys + i * sizeof(double), sizeof(double));
+            instances.x[i] = px;
+            instances.y[i] = py;
+            grid->countPoint(px, py);
+        }
+    } else {
+        readColumn(file, header.xOffset, count, instances.x);
+        readColumn(file, header.yOffset, count, instances.y);
+    }
+    readColumn(file, header.typeOffset, count, instances.type);
+    readColumn(file, header.origIdOffset, count, instances.origId);
+    if (count > 0) instances.bounds = { header.minX, header.minY, header.maxX, header.maxY };
+    if (binWhileCopying) grid->place(instances);
+
+    for (auto& type : instances.type) {
+        if (type >= remap.size()) throw snapshotError(filepath, "feature code out of range");
+        type = remap[type];
+    }
+    if (options.filters()) dropFilteredRows(instances, options);
+
+    if (finalOrder) {
+        instances.spatiallyOrdered = (header.flags & cbin::FLAG_SPATIALLY_ORDERED) != 0;
+        instances.featureMajor = true;
+    } else {
+        instances.sortSpatially();
+    }
+    if (grid != nullptr && !binWhileCopying) *grid = SpatialGrid::build(instances, distance);
+    return instances;
+}
+
+} // namespace
+
+bool DataLoader::isSnapshotPath(const std::string& filepath) {
+    const std::string ext = ".cbin";
+    return filepath.size() >= ext.size() && filepath.compare(filepath.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+void DataLoader::save_snapshot(const InstanceStore& instances, const std::string& filepath) {
+    cbin::Header header{};
+    std::memcpy(header.magic, cbin::MAGIC, sizeof(header.magic));
+    header.version = cbin::VERSION;
+    header.byteOrder = cbin::BYTE_ORDER_MARK;
+    header.flags = (instances.spatiallyOrdered ? cbin::FLAG_SPATIALLY_ORDERED : 0u) |
+                   (instances.featureMajor ? cbin::FLAG_FEATURE_MAJOR : 0u);
+    header.featureCount = static_cast<std::uint32_t>(instances.features.size());
+    header.count = instances.size();
+
+    if (!instances.empty()) {
+        header.minX = instances.bounds.minX;
+        header.minY = instances.bounds.minY;
+        header.maxX = instances.bounds.maxX;
+        header.maxY = instances.bounds.maxY;
+    }
+
+    header.dictOffset = cbin::alignUp(sizeof(cbin::Header));
+    for (FeatureType code = 0; code < instances.features.size(); ++code) {
+        header.dictBytes += sizeof(std::uint32_t) + instances.features.name(code).size();
+    }
+    header.xOffset = cbin::alignUp(header.dictOffset + header.dictBytes);
+    header.yOffset = cbin::alignUp(header.xOffset + header.count * sizeof(double));
+    header.typeOffset = cbin::alignUp(header.yOffset + header.count * sizeof(double));
+    header.origIdOffset = cbin::alignUp(header.typeOffset + header.count * sizeof(FeatureType));
+
+    // Write next to the target and rename at the end, so that an interrupted
+    // conversion never leaves a truncated snapshot under the real name
+    const std::string tmpPath = filepath + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) throw snapshotError(filepath, "cannot create '" + tmpPath + "'");
+
+        std::uint64_t offset = 0;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        offset += sizeof(header);
+
+        padTo(out, offset, header.dictOffset);
+        for (FeatureType code = 0; code < instances.features.size(); ++code) {
+            const std::string& name = instances.features.name(code);
+            const auto length = static_cast<std::uint32_t>(name.size());
+            out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+            out.write(name.data(), static_cast<std::streamsize>(name.size()));
+            offset += sizeof(length) + name.size();
+        }
+
+        padTo(out, offset, header.xOffset);
+        writeColumn(out, offset, instances.x);
+        padTo(out, offset, header.yOffset);
+        writeColumn(out, offset, instances.y);
+        padTo(out, offset, header.typeOffset);
+        writeColumn(out, offset, instances.type);
+        padTo(out, offset, header.origIdOffset);
+        writeColumn(out, offset, instances.origId);
+
+        if (!out.flush()) throw snapshotError(filepath, "write failed");
+    }
+
+    // No remove() first: the rename replaces an older snapshot atomically
+    std::error_code error;
+    std::filesystem::rename(tmpPath, filepath, error);
+    if (error) throw snapshotError(filepath, "cannot rename '" + tmpPath + "': " + error.message());
+}
+
+InstanceStore DataLoader::load_snapshot(const std::string& filepath, const LoadOptions& options) {
+    return readSnapshot(filepath, options, nullptr, 0.0);
+}
+
+GriddedDataset DataLoader::load_gridded(const std::string& filepath, const LoadOptions& options, double distance) {
+    GriddedDataset dataset;
+    if (isSnapshotPath(filepath) && !isMultiFilePath(filepath)) {
+        dataset.instances = readSnapshot(filepath, options, &dataset.grid, distance);
+    } else {
+        // The parsers track the bounding box row by row, so binning needs no
+        // extra pass for it (and neither does sortSpatially())
+        dataset.instances = load(filepath, options);
+        dataset.grid = SpatialGrid::build(dataset.instances, distance);
+    }
+    return dataset;
+}
+
+SnapshotRows::SnapshotRows(const std::string& filepath) : path(filepath), file(filepath) {
+    remap = readHeader(file, path, header, dictionary);
+    ordered = isFinalOrder(header, remap);
+}
+
+FeatureType SnapshotRows::type(size_t i) const {
+    const FeatureType stored = read<FeatureType>(header.typeOffset, i);
+    if (stored >= remap.size()) throw snapshotError(path, "feature code out of range");
+    return remap[stored];
+}
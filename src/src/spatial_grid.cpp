@@ -0,0 +1,158 @@
+/**
+ * @file spatial_grid.cpp
+ * @brief Implementation of the uniform grid
+ */
+
+#include "spatial_grid.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+SpatialGrid::SpatialGrid(const BoundingBox& bounds, double reach, size_t instanceCount, GridLayout layout,
+                         unsigned refinement)
+    : minX(bounds.minX), minY(bounds.minY), reach(reach), refinement(refinement), cellSize(reach / refinement) {
+    if (!(reach > 0.0)) throw std::invalid_argument("SpatialGrid: neighbor distance must be positive");
+    if (refinement == 0) throw std::invalid_argument("SpatialGrid: refinement must be positive");
+
+    // Grid dimensions from the distance threshold; at least one cell even when
+    // all points share a coordinate (min == max). Computed in double first:
+    // the axes may be too long for an integer, and their product usually is.
+    const double spanX = std::ceil((bounds.maxX - bounds.minX) / cellSize);
+    const double spanY = std::ceil((bounds.maxY - bounds.minY) / cellSize);
+    constexpr double MAX_AXIS_CELLS = 4611686018427387904.0;   // 2^62
+    if (!(spanX <= MAX_AXIS_CELLS) || !(spanY <= MAX_AXIS_CELLS)) {
+        throw std::invalid_argument("SpatialGrid: cell size too small for the extent");
+    }
+    cellsX = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(spanX));
+    cellsY = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(spanY));
+
+    const double denseCells = static_cast<double>(cellsX) * static_cast<double>(cellsY);
+    // Past 2^32 cells the offsets alone would take 16 GB
+    const bool denseFits = denseCells < 4294967295.0;
+    switch (layout) {
+    case GridLayout::Dense:
+        if (!denseFits) throw std::invalid_argument("SpatialGrid: too many cells for a dense grid");
+        sparse = false;
+        break;
+    case GridLayout::Sparse:
+        sparse = true;
+        break;
+    case GridLayout::Auto:
+        // Dense costs 4 bytes per cell, occupied or not; sparse about 28 per
+        // occupied cell. Past a few cells per instance most cells are empty.
+        sparse = !denseFits ||
+                 denseCells > DENSE_CELLS_PER_INSTANCE * static_cast<double>(std::max<size_t>(instanceCount, 1024));
+        break;
+    }
+
+    if (sparse) {
+        cellStart.assign(1, 0);
+        slots.assign(64, 0);
+    } else {
+        cellStart.assign(static_cast<size_t>(cellsX * cellsY) + 1, 0);
+    }
+}
+
+size_t SpatialGrid::addCell(CellCoord coord) {
+    const size_t found = findCell(coord);
+    if (found != NO_CELL) return found;
+
+    const size_t c = cellCoords.size();
+    cellCoords.push_back(coord);
+    cellStart.push_back(0);
+
+    // Keep the table at most half full; on growth re-insert every stored cell
+    if (2 * cellCoords.size() > slots.size()) {
+        slots.assign(2 * slots.size(), 0);
+        for (size_t k = 0; k < cellCoords.size(); ++k) {
+            size_t i = slotOf(cellCoords[k]);
+            while (slots[i] != 0) i = (i + 1) & (slots.size() - 1);
+            slots[i] = static_cast<std::uint32_t>(k + 1);
+        }
+    } else {
+        size_t i = slotOf(coord);
+        while (slots[i] != 0) i = (i + 1) & (slots.size() - 1);
+        slots[i] = static_cast<std::uint32_t>(c + 1);
+    }
+    return c;
+}
+
+void SpatialGrid::place(const InstanceStore& instances) {
+    // cellStart[c + 1] holds the count of cell c; the prefix sum turns it into
+    // the end of cell c, i.e. cellStart[c] becomes the start of cell c.
+    const size_t cells = cellCount();
+    for (size_t c = 0; c < cells; ++c) {
+        cellStart[c + 1] += cellStart[c];
+    }
+
+    // cellStart[c] doubles as the write cursor of cell c
+    cellInstances.resize(instances.size());
+    cellX.resize(instances.size());
+    cellY.resize(instances.size());
+    for (InstanceId id = 0; id < instances.size(); ++id) {
+        const double x = instances.x[id];
+        const double y = instances.y[id];
+        const std::uint32_t slot = cellStart[cellOf(x, y)]++;
+        cellInstances[slot] = id;
+        cellX[slot] = x;
+        cellY[slot] = y;
+    }
+
+    // Each cursor stopped at the end of its cell = the start of the next one;
+    // shift them back by one cell.
+    for (size_t c = cells; c > 0; --c) {
+        cellStart[c] = cellStart[c - 1];
+    }
+    cellStart[0] = 0;
+
+    // Order each cell by x (ties by id, so the layout is deterministic). Ids
+    // were placed in ascending order, so cells of one point are already done.
+    struct Entry {
+        double x, y;
+        InstanceId id;
+    };
+    std::vector<Entry> scratch;
+    for (size_t c = 0; c < cells; ++c) {
+        const size_t first = cellStart[c];
+        const size_t last = cellStart[c + 1];
+        if (last - first < 2) continue;
+
+        scratch.clear();
+        for (size_t i = first; i < last; ++i) {
+            scratch.push_back({ cellX[i], cellY[i], cellInstances[i] });
+        }
+        std::sort(scratch.begin(), scratch.end(), [](const Entry& a, const Entry& b) {
+            return a.x < b.x || (a.x == b.x && a.id < b.id);
+        });
+        for (size_t i = first; i < last; ++i) {
+            cellX[i] = scratch[i - first].x;
+            cellY[i] = scratch[i - first].y;
+            cellInstances[i] = scratch[i - first].id;
+        }
+    }
+}
+
+std::vector<CellOffset> SpatialGrid::forwardStencil() const {
+    const int k = static_cast<int>(refinement);
+    std::vector<CellOffset> stencil;
+    for (int dy = 0; dy <= k; ++dy) {
+        for (int dx = -k; dx <= k; ++dx) {
+            if (dy == 0 && dx <= 0) continue;
+            const int gapX = std::max(std::abs(dx) - 1, 0);
+            const int gapY = std::max(dy - 1, 0);
+            if (gapX * gapX + gapY * gapY <= k * k) stencil.push_back({ dx, dy });
+        }
+    }
+    return stencil;
+}
+
+SpatialGrid SpatialGrid::build(const InstanceStore& instances, double reach, GridLayout layout, unsigned refinement) {
+    if (instances.empty()) return SpatialGrid();
+
+    SpatialGrid grid(instances.bounds, reach, instances.size(), layout, refinement);
+    for (InstanceId id = 0; id < instances.size(); ++id) {
+        grid.countPoint(instances.x[id], instances.y[id]);
+    }
+    grid.place(instances);
+    return grid;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file spatial_index.cpp
+ * @brief Backend selection, shared distance helpers and the grid backend
+ */
+
+#include "spatial_index.h"
+#include "distance_kernel.h"
+#include "kd_tree.h"
+#include "r_tree.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+SpatialIndexKind parseSpatialIndexKind(const std::string& name) {
+    if (name == "grid") return SpatialIndexKind::Grid;
+    if (name == "kdtree") return SpatialIndexKind::KdTree;
+    if (name == "rtree") return SpatialIndexKind::RTree;
+    throw std::invalid_argument("Unknown spatial index '" + name + "' (expected grid, kdtree or rtree)");
+}
+
+const char* spatialIndexName(SpatialIndexKind kind) {
+    switch (kind) {
+    case SpatialIndexKind::KdTree: return "kdtree";
+    case SpatialIndexKind::RTree: return "rtree";
+    default: return "grid";
+    }
+}
+
+std::unique_ptr<SpatialIndex> SpatialIndex::build(SpatialIndexKind kind, const InstanceStore& instances, double reach) {
+    switch (kind) {
+    case SpatialIndexKind::KdTree: return std::make_unique<KdTree>(instances);
+    case SpatialIndexKind::RTree: return std::make_unique<RTree>(instances);
+    default: return std::make_unique<GridIndex>(SpatialGrid::build(instances, reach));
+    }
+}
+
+bool SpatialIndex::boxBeyond(const BoundingBox& box, double x, double y, double r2) {
+    // Gap from (x, y) to the box along each axis (0 when inside the slab)
+    const double gapX = x < box.minX ? box.minX - x : (x > box.maxX ? x - box.maxX : 0.0);
+    const double gapY = y < box.minY ? box.minY - y : (y > box.maxY ? y - box.maxY : 0.0);
+    return gapX * gapX + gapY * gapY > r2;
+}
+
+bool SpatialIndex::boxWithin(const BoundingBox& box, double x, double y, double r2) {
+    // Distance to the farthest corner
+    const double farX = std::max(x - box.minX, box.maxX - x);
+    const double farY = std::max(y - box.minY, box.maxY - y);
+    return farX * farX + farY * farY <= r2;
+}
+
+void SpatialIndex::appendWithin(double x, double y, const InstanceId* ids, const double* xs, const double* ys,
+                                size_t count, double r2, std::vector<InstanceId>& out) {
+    static const distance_kernel::BlockFn withinDistance = distance_kernel::select();
+    for (size_t block = 0; block < count; block += distance_kernel::BLOCK) {
+        std::uint64_t mask = withinDistance(x, y, xs + block, ys + block,
+                                            std::min(distance_kernel::BLOCK, count - block), r2);
+        while (mask != 0) {
+            out.push_back(ids[block + distance_kernel::lowestBit(mask)]);
+            mask &= mask - 1;
+        }
+    }
+}
+
+void GridIndex::query(double x, double y, double radius, std::vector<InstanceId>& out) const {
+    if (cells.empty()) return;
+    const double r2 = radius * radius;
+
+    // Columns and rows overlapping [x - radius, x + radius] x [y - radius, y + radius],
+    // clamped to the extent
+    auto axisRange = [&](double lo, double hi, double min, std::uint64_t count, std::uint64_t& first,
+                         std::uint64_t& last) {
+        const double a = std::floor((lo - min) / cells.cellSize);
+        const double b = std::floor((hi - min) / cells.cellSize);
+        const double top = static_cast<double>(count - 1);
+        first = a <= 0.0 ? 0 : static_cast<std::uint64_t>(std::min(a, top));
+        last = b <= 0.0 ? 0 : static_cast<std::uint64_t>(std::min(b, top));
+    };
+    std::uint64_t firstX, lastX, firstY, lastY;
+    axisRange(x - radius, x + radius, cells.minX, cells.cellsX, firstX, lastX);
+    axisRange(y - radius, y + radius, cells.minY, cells.cellsY, firstY, lastY);
+
+    for (std::uint64_t cy = firstY; cy <= lastY; ++cy) {
+        for (std::uint64_t cx = firstX; cx <= lastX; ++cx) {
+            const size_t c = cells.findCell({ cx, cy });
+            if (c == SpatialGrid::NO_CELL) continue;
+            const size_t first = cells.cellStart[c];
+            appendWithin(x, y, cells.cellInstances.data() + first, cells.cellX.data() + first,
+                         cells.cellY.data() + first, cells.cellStart[c + 1] - first, r2, out);
+        }
+    }
+}
+
+size_t GridIndex::memoryBytes() const {
+    return cells.cellStart.capacity() * sizeof(std::uint32_t) +
+           cells.cellInstances.capacity() * sizeof(InstanceId) +
+           (cells.cellX.capacity() + cells.cellY.capacity()) * sizeof(double) +
+           cells.cellCoords.capacity() * sizeof(CellCoord) + cells.slots.capacity() * sizeof(std::uint32_t);
+}
@@ -0,0 +1,554 @@
+/**
+ * @file tiled_neighborhood.cpp
+ * @brief Tiling, per-tile materialization with spilling, and tile-by-tile IDS
+ */
+
+#include "tiled_neighborhood.h"
+#include "cbin_format.h"
+#include "data_loader.h"
+#include "ids_tree.h"
+#include "mapped_file.h"
+#include "snapshot_rows.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// tile_<k>.ids: header, count x uint32 global id, count x uint8 core flag
+constexpr char IDS_MAGIC[8] = { 'C', 'L', 'Q', 'T', 'I', 'L', 'E', '\0' };
+constexpr std::uint32_t IDS_VERSION = 1;
+
+struct IdsHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint64_t count;
+};
+
+std::runtime_error tileError(const std::string& path, const std::string& what) {
+    return std::runtime_error("TiledNeighborhood: '" + path + "': " + what);
+}
+
+void writeTileIds(const std::string& path, const std::vector<InstanceId>& ids, const std::vector<std::uint8_t>& core) {
+    IdsHeader header{};
+    std::memcpy(header.magic, IDS_MAGIC, sizeof(header.magic));
+    header.version = IDS_VERSION;
+    header.byteOrder = cbin::BYTE_ORDER_MARK;
+    header.count = ids.size();
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw tileError(path, "cannot create file");
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(ids.data()), static_cast<std::streamsize>(ids.size() * sizeof(InstanceId)));
+    out.write(reinterpret_cast<const char*>(core.data()), static_cast<std::streamsize>(core.size()));
+    if (!out.flush()) throw tileError(path, "write failed");
+}
+
+void readTileIds(const std::string& path, std::vector<InstanceId>& ids, std::vector<std::uint8_t>& core) {
+    MappedFile file(path);
+    IdsHeader header;
+    if (file.size() < sizeof(header)) throw tileError(path, "file too small");
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, IDS_MAGIC, sizeof(header.magic)) != 0 || header.version != IDS_VERSION ||
+        header.byteOrder != cbin::BYTE_ORDER_MARK) {
+        throw tileError(path, "not a tile id file of this version and byte order");
+    }
+    if (header.count > file.size() ||
+        file.size() - sizeof(header) != header.count * (sizeof(InstanceId) + sizeof(std::uint8_t))) {
+        throw tileError(path, "truncated or corrupt");
+    }
+    ids.resize(header.count);
+    core.resize(header.count);
+    std::memcpy(ids.data(), file.data() + sizeof(header), ids.size() * sizeof(InstanceId));
+    std::memcpy(core.data(), file.data() + sizeof(header) + ids.size() * sizeof(InstanceId), core.size());
+}
+
+// tile_<k>.cliques: per clique a uint32 size, then its ids. Written and read
+// back by the same runIds() call, so there is no header
+void writeClique(std::ofstream& out, const std::vector<InstanceId>& clique) {
+    const std::uint32_t size = static_cast<std::uint32_t>(clique.size());
+    out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    out.write(reinterpret_cast<const char*>(clique.data()), static_cast<std::streamsize>(size * sizeof(InstanceId)));
+}
+
+bool readClique(std::ifstream& in, std::vector<InstanceId>& clique, const std::string& path) {
+    std::uint32_t size = 0;
+    if (!in.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+        if (in.gcount() == 0 && in.eof()) return false;
+        throw tileError(path, "truncated clique run");
+    }
+    clique.resize(size);
+    if (!in.read(reinterpret_cast<char*>(clique.data()), static_cast<std::streamsize>(size * sizeof(InstanceId)))) {
+        throw tileError(path, "truncated clique run");
+    }
+    return true;
+}
+
+void removeTileFiles(const std::string& path) {
+    for (const char* ext : { ".cbin", ".ids", ".csr", ".cliques" }) std::remove((path + ext).c_str());
+}
+
+// Median of `values` for a split along one axis. Instances at the median go
+// right, unless that leaves the left side empty (the median is the minimum);
+// then they go left (`inclusive`). False if every value is the same
+bool medianSplit(std::vector<double>& values, double& median, bool& inclusive) {
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    median = values[values.size() / 2];
+    inclusive = false;
+    size_t leftCount = 0;
+    for (double v : values) leftCount += v < median;
+    if (leftCount == 0) {
+        inclusive = true;
+        for (double v : values) leftCount += v == median;
+        if (leftCount == values.size()) return false;
+    }
+    return true;
+}
+
+// Whether (x, y) lies in `rect` grown by d on every side: a box test, which
+// keeps a superset of the points within d of the rectangle
+bool inHalo(const BoundingBox& rect, double distance, double x, double y) {
+    return x >= rect.minX - distance && x <= rect.maxX + distance && y >= rect.minY - distance &&
+           y <= rect.maxY + distance;
+}
+
+// Split tree of partition(snapshotPath), built on a sample of the rows
+struct SplitNode {
+    BoundingBox rect;
+    bool alongX = true;
+    double median = 0.0;
+    bool inclusive = false;
+    size_t left = 0;    ///< Children; 0 for a leaf (the root is never a child)
+    size_t right = 0;
+    size_t leaf = 0;    ///< Number of the leaf region
+};
+
+// Bisect the sample rows `members` like TiledNeighborhood::bisect() until
+// each region holds an estimated `maxCore` rows (`weight` rows per sample)
+size_t splitSample(const std::vector<double>& xs, const std::vector<double>& ys, std::vector<std::uint32_t> members,
+                   const BoundingBox& rect, double weight, size_t maxCore, std::vector<SplitNode>& nodes,
+                   size_t& leaves) {
+    const size_t index = nodes.size();
+    nodes.emplace_back();
+    nodes[index].rect = rect;
+    const bool xLonger = rect.maxX - rect.minX >= rect.maxY - rect.minY;
+
+    for (int attempt = 0; attempt < 2 && static_cast<double>(members.size()) * weight > maxCore; ++attempt) {
+        const bool alongX = (attempt == 0) == xLonger;
+        const std::vector<double>& axis = alongX ? xs : ys;
+        std::vector<double> values;
+        values.reserve(members.size());
+        for (std::uint32_t k : members) values.push_back(axis[k]);
+        double median;
+        bool inclusive;
+        if (!medianSplit(values, median, inclusive)) continue;
+
+        std::vector<std::uint32_t> left, right;
+        for (std::uint32_t k : members) {
+            ((inclusive ? axis[k] <= median : axis[k] < median) ? left : right).push_back(k);
+        }
+        std::vector<std::uint32_t>().swap(members);
+        BoundingBox leftRect = rect, rightRect = rect;
+        (alongX ? leftRect.maxX : leftRect.maxY) = median;
+        (alongX ? rightRect.minX : rightRect.minY) = median;
+        const size_t leftNode = splitSample(xs, ys, std::move(left), leftRect, weight, maxCore, nodes, leaves);
+        const size_t rightNode = splitSample(xs, ys, std::move(right), rightRect, weight, maxCore, nodes, leaves);
+        SplitNode& node = nodes[index];
+        node.alongX = alongX;
+        node.median = median;
+        node.inclusive = inclusive;
+        node.left = leftNode;
+        node.right = rightNode;
+        return index;
+    }
+    nodes[index].leaf = leaves++;
+    return index;
+}
+
+// One row of a spill file: a core or halo instance of one region
+struct SpillRecord {
+    double x, y;
+    std::int32_t origId;
+    FeatureType type;
+    std::uint8_t core;
+    InstanceId id;
+};
+
+} // namespace
+
+TiledNeighborhood::TiledNeighborhood(std::string directory, double distance, size_t maxCorePoints)
+    : directory(std::move(directory)), distance(distance), maxCorePoints(std::max<size_t>(1, maxCorePoints)) {
+    if (!(distance > 0.0)) throw std::invalid_argument("TiledNeighborhood: neighbor distance must be positive");
+}
+
+void TiledNeighborhood::partition(const InstanceStore& instances) {
+    if (!instances.featureMajor) {
+        throw std::invalid_argument("TiledNeighborhood: instances must be feature-major (sortSpatially() order)");
+    }
+    removeFiles();
+    std::filesystem::create_directories(directory);
+    if (instances.empty()) return;
+
+    std::vector<InstanceId> globalIds(instances.size());
+    Part whole;
+    whole.core.resize(instances.size());
+    for (InstanceId id = 0; id < instances.size(); ++id) {
+        globalIds[id] = id;
+        whole.core[id] = id;
+    }
+    whole.rect = instances.bounds;
+    bisect(instances, globalIds, std::move(whole), maxCorePoints, tileList);
+}
+
+void TiledNeighborhood::partition(const std::string& snapshotPath) {
+    const SnapshotRows rows(snapshotPath);
+    if (!rows.finalOrder()) {
+        throw std::invalid_argument("TiledNeighborhood: snapshot '" + snapshotPath +
+                                    "' is not in feature-major order");
+    }
+    removeFiles();
+    std::filesystem::create_directories(directory);
+    if (rows.empty()) return;
+    const size_t n = rows.size();
+
+    // Split tree on every (n / sampleSize)-th row, split like bisect() until
+    // each region should hold at most maxCorePoints core instances
+    const size_t expectedTiles = (n + maxCorePoints - 1) / maxCorePoints;
+    const size_t sampleSize = std::min(n, std::max(SAMPLE_MIN, SAMPLE_PER_TILE * expectedTiles));
+    std::vector<double> sampleX(sampleSize), sampleY(sampleSize);
+    for (size_t k = 0; k < sampleSize; ++k) {
+        const size_t i = static_cast<size_t>(static_cast<double>(k) * static_cast<double>(n) / sampleSize);
+        sampleX[k] = rows.x(std::min(i, n - 1));
+        sampleY[k] = rows.y(std::min(i, n - 1));
+    }
+    std::vector<std::uint32_t> members(sampleSize);
+    std::iota(members.begin(), members.end(), 0u);
+    std::vector<SplitNode> nodes;
+    size_t leafCount = 0;
+    splitSample(sampleX, sampleY, std::move(members), rows.bounds(), static_cast<double>(n) / sampleSize,
+                maxCorePoints, nodes, leafCount);
+    std::vector<double>().swap(sampleX);
+    std::vector<double>().swap(sampleY);
+
+    std::vector<BoundingBox> leafRects(leafCount);
+    for (const SplitNode& node : nodes) {
+        if (node.left == 0) leafRects[node.leaf] = node.rect;
+    }
+    std::vector<std::string> spillPaths(leafCount);
+    for (size_t leaf = 0; leaf < leafCount; ++leaf) {
+        spillPaths[leaf] = (std::filesystem::path(directory) / ("region_" + std::to_string(leaf) + ".spill")).string();
+        std::remove(spillPaths[leaf].c_str());   // Appended to below
+    }
+
+    try {
+        // One pass over the rows in id order: each goes to the spill file of
+        // the region whose core it is in, and of every region whose rectangle
+        // grown by d contains it (halo, the same box test as bisect())
+        std::vector<std::vector<SpillRecord>> buffers(leafCount);
+        const size_t flushAt = std::max<size_t>(64, SPILL_BUFFER / leafCount);
+        auto flush = [&](size_t leaf) {
+            std::vector<SpillRecord>& buffer = buffers[leaf];
+            if (buffer.empty()) return;
+            std::ofstream out(spillPaths[leaf], std::ios::binary | std::ios::app);
+            out.write(reinterpret_cast<const char*>(buffer.data()),
+                      static_cast<std::streamsize>(buffer.size() * sizeof(SpillRecord)));
+            if (!out.flush()) throw tileError(spillPaths[leaf], "write failed");
+            buffer.clear();
+        };
+
+        std::vector<size_t> pending;
+        for (size_t i = 0; i < n; ++i) {
+            const SpillRecord record{ rows.x(i), rows.y(i), rows.origId(i), rows.type(i), 0,
+                                      static_cast<InstanceId>(i) };
+
+            size_t node = 0;
+            while (nodes[node].left != 0) {
+                const SplitNode& split = nodes[node];
+                const double v = split.alongX ? record.x : record.y;
+                node = (split.inclusive ? v <= split.median : v < split.median) ? split.left : split.right;
+            }
+            const size_t coreLeaf = nodes[node].leaf;
+
+            pending.assign(1, 0);
+            while (!pending.empty()) {
+                const SplitNode& visit = nodes[pending.back()];
+                pending.pop_back();
+                if (!inHalo(visit.rect, distance, record.x, record.y)) continue;
+                if (visit.left != 0) {
+                    pending.push_back(visit.right);
+                    pending.push_back(visit.left);
+                    continue;
+                }
+                buffers[visit.leaf].push_back(record);
+                buffers[visit.leaf].back().core = visit.leaf == coreLeaf ? 1 : 0;
+                if (buffers[visit.leaf].size() >= flushAt) flush(visit.leaf);
+            }
+        }
+        for (size_t leaf = 0; leaf < leafCount; ++leaf) flush(leaf);
+        std::vector<std::vector<SpillRecord>>().swap(buffers);
+
+        // Each region on its own: rows are in id order already, so the region
+        // is a feature-major store that bisect() cuts to the exact core limit
+        for (size_t leaf = 0; leaf < leafCount; ++leaf) {
+            std::vector<SpillRecord> records;
+            if (std::filesystem::exists(spillPaths[leaf])) {
+                records.resize(std::filesystem::file_size(spillPaths[leaf]) / sizeof(SpillRecord));
+                std::ifstream in(spillPaths[leaf], std::ios::binary);
+                if (!in.read(reinterpret_cast<char*>(records.data()),
+                             static_cast<std::streamsize>(records.size() * sizeof(SpillRecord)))) {
+                    throw tileError(spillPaths[leaf], "truncated spill file");
+                }
+                in.close();
+                std::remove(spillPaths[leaf].c_str());
+            }
+
+            InstanceStore local;
+            local.features = rows.features();
+            local.reserve(records.size());
+            std::vector<InstanceId> ids;
+            ids.reserve(records.size());
+            Part part;
+            part.rect = leafRects[leaf];
+            for (const SpillRecord& record : records) {
+                (record.core ? part.core : part.halo).push_back(static_cast<std::uint32_t>(local.size()));
+                local.push_back(record.type, record.origId, record.x, record.y);
+                ids.push_back(record.id);
+            }
+            local.featureMajor = true;
+            // A region the sample saw but no row fell into has nothing to search
+            if (!part.core.empty()) bisect(local, ids, std::move(part), maxCorePoints, tileList);
+        }
+    } catch (...) {
+        for (const std::string& path : spillPaths) std::remove(path.c_str());
+        throw;
+    }
+}
+
+void TiledNeighborhood::bisect(const InstanceStore& source, const std::vector<InstanceId>& globalIds, Part part,
+                               size_t maxCore, std::vector<Tile>& out) {
+    const BoundingBox& rect = part.rect;
+    const bool xLonger = rect.maxX - rect.minX >= rect.maxY - rect.minY;
+
+    // Longer side first; the other one if every core instance has the same
+    // coordinate along it
+    for (int attempt = 0; attempt < 2 && part.core.size() > maxCore; ++attempt) {
+        const bool alongX = (attempt == 0) == xLonger;
+        const std::vector<double>& axis = alongX ? source.x : source.y;
+
+        std::vector<double> values;
+        values.reserve(part.core.size());
+        for (std::uint32_t i : part.core) values.push_back(axis[i]);
+        double median;
+        bool inclusive;
+        if (!medianSplit(values, median, inclusive)) continue;
+        auto goesLeft = [&](std::uint32_t i) { return inclusive ? axis[i] <= median : axis[i] < median; };
+
+        Part left, right;
+        left.rect = rect;
+        right.rect = rect;
+        (alongX ? left.rect.maxX : left.rect.maxY) = median;
+        (alongX ? right.rect.minX : right.rect.minY) = median;
+        for (std::uint32_t i : part.core) (goesLeft(i) ? left.core : right.core).push_back(i);
+
+        // A child's halo comes from the parent's halo and the other child's
+        // core: everything within d of its rectangle (a box test, which keeps
+        // a superset of the points within d)
+        auto haloOf = [&](const Part& child, const std::vector<std::uint32_t>& siblingCore) {
+            std::vector<std::uint32_t> candidates(part.halo.size() + siblingCore.size());
+            std::merge(part.halo.begin(), part.halo.end(), siblingCore.begin(), siblingCore.end(), candidates.begin());
+            std::vector<std::uint32_t> halo;
+            for (std::uint32_t i : candidates) {
+                        if (inHalo(child.rect, distance, source.x[i], source.y[i])) halo.push_back(i);
+            }
+            return halo;
+        };
+        left.halo = haloOf(left, right.core);
+        right.halo = haloOf(right, left.core);
+
+        Part().core.swap(part.core);   // Release the parent's lists before recursing
+        Part().halo.swap(part.halo);
+        bisect(source, globalIds, std::move(left), maxCore, out);
+        bisect(source, globalIds, std::move(right), maxCore, out);
+        return;
+    }
+    out.push_back(writeTile(source, globalIds, part));
+}
+
+TiledNeighborhood::Tile TiledNeighborhood::writeTile(const InstanceStore& source,
+                                                     const std::vector<InstanceId>& globalIds, const Part& part) {
+    Tile tile;
+    tile.path = (std::filesystem::path(directory) / ("tile_" + std::to_string(nextTile++))).string();
+    tile.rect = part.rect;
+    tile.corePoints = part.core.size();
+    tile.points = part.core.size() + part.halo.size();
+
+    // Core and halo merged back into source order
+    InstanceStore local;
+    local.features = source.features;
+    local.reserve(tile.points);
+    std::vector<InstanceId> ids;
+    std::vector<std::uint8_t> core;
+    ids.reserve(tile.points);
+    core.reserve(tile.points);
+    size_t c = 0, h = 0;
+    while (c < part.core.size() || h < part.halo.size()) {
+        const bool fromCore = h == part.halo.size() || (c < part.core.size() && part.core[c] < part.halo[h]);
+        const std::uint32_t i = fromCore ? part.core[c++] : part.halo[h++];
+        local.push_back(source.type[i], source.origId[i], source.x[i], source.y[i]);
+        ids.push_back(globalIds[i]);
+        core.push_back(fromCore ? 1 : 0);
+    }
+    // A subsequence of a feature-major order is feature-major; the snapshot
+    // keeps it as is, so local ids compare like global ones
+    local.featureMajor = true;
+
+    DataLoader::save_snapshot(local, tile.path + ".cbin");
+    writeTileIds(tile.path + ".ids", ids, core);
+    return tile;
+}
+
+void TiledNeighborhood::materialize(NeighborhoodMgr& neighborMgr) {
+    // Tiles split on the way are appended and reached later in the loop
+    for (size_t k = 0; k < tileList.size();) {
+        if (tileList[k].materialized) {
+            ++k;
+            continue;
+        }
+        const Tile tile = tileList[k];
+        InstanceStore local = DataLoader::load_snapshot(tile.path + ".cbin");
+        try {
+            neighborMgr.materialize(local, distance);
+        } catch (const std::length_error&) {
+            // Over budget: split the core in two and retry both halves
+            Part part;
+            std::vector<InstanceId> ids;
+            std::vector<std::uint8_t> core;
+            readTileIds(tile.path + ".ids", ids, core);
+            for (std::uint32_t i = 0; i < core.size(); ++i) (core[i] ? part.core : part.halo).push_back(i);
+            part.rect = tile.rect;
+
+            std::vector<Tile> halves;
+            bisect(local, ids, std::move(part), std::max<size_t>(1, tile.corePoints / 2), halves);
+            if (halves.size() < 2) {
+                removeTileFiles(halves.front().path);   // Cannot split any further
+                throw;
+            }
+            removeTileFiles(tile.path);
+            tileList[k] = halves[0];
+            tileList.insert(tileList.end(), halves.begin() + 1, halves.end());
+            continue;
+        }
+        neighborMgr.getAllNeighbors().save(tile.path + ".csr");
+        neighborMgr.setGraph(NeighborGraph());
+        tileList[k].materialized = true;
+        ++k;
+    }
+}
+
+std::vector<std::string> TiledNeighborhood::spillIds() const {
+    std::vector<std::string> paths;
+    try {
+        for (const Tile& tile : tileList) {
+            if (!tile.materialized) {
+                throw std::logic_error("TiledNeighborhood: tile '" + tile.path + "' not materialized");
+            }
+
+            InstanceStore local = DataLoader::load_snapshot(tile.path + ".cbin");
+            std::vector<InstanceId> ids;
+            std::vector<std::uint8_t> core;
+            readTileIds(tile.path + ".ids", ids, core);
+            NeighborhoodMgr neighborMgr;
+            neighborMgr.setGraph(NeighborGraph::load(tile.path + ".csr"));
+            if (ids.size() != local.size() || neighborMgr.getAllNeighbors().size() != local.size()) {
+                throw tileError(tile.path, "tile files do not match");
+            }
+
+            std::vector<InstanceId> heads;
+            heads.reserve(tile.corePoints);
+            for (InstanceId i = 0; i < core.size(); ++i) {
+                if (core[i]) heads.push_back(i);
+            }
+
+            paths.push_back(tile.path + ".cliques");
+            std::ofstream out(paths.back(), std::ios::binary | std::ios::trunc);
+            if (!out) throw tileError(paths.back(), "cannot create file");
+            // Heads in id order, batch by batch: the run stays sorted by head
+            IDSTree tree(neighborMgr, local);
+            for (size_t first = 0; first < heads.size(); first += HEAD_BATCH) {
+                const size_t count = std::min(HEAD_BATCH, heads.size() - first);
+                for (std::vector<InstanceId>& clique : tree.run(InstanceSpan(heads.data() + first, count))) {
+                    for (InstanceId& id : clique) id = ids[id];
+                    writeClique(out, clique);
+                }
+            }
+            if (!out.flush()) throw tileError(paths.back(), "write failed");
+        }
+    } catch (...) {
+        for (const std::string& path : paths) std::remove(path.c_str());
+        throw;
+    }
+    return paths;
+}
+
+struct TiledNeighborhood::CliqueRuns::Run {
+    std::string path;
+    std::ifstream in;
+    std::vector<InstanceId> current;   ///< Next clique of this run
+
+    ~Run() {
+        in.close();
+        std::remove(path.c_str());
+    }
+};
+
+TiledNeighborhood::CliqueRuns::CliqueRuns(std::vector<std::string> paths) {
+    // Own every file first, so that all of them are removed if opening one fails
+    runs.reserve(paths.size());
+    for (std::string& path : paths) {
+        runs.push_back(std::make_unique<Run>());
+        runs.back()->path = std::move(path);
+    }
+    for (size_t r = 0; r < runs.size(); ++r) {
+        Run& run = *runs[r];
+        run.in.open(run.path, std::ios::binary);
+        if (!run.in) throw tileError(run.path, "cannot open clique run");
+        if (readClique(run.in, run.current, run.path)) heap.push_back(r);
+    }
+    const auto later = [this](size_t a, size_t b) { return runs[a]->current.front() > runs[b]->current.front(); };
+    std::make_heap(heap.begin(), heap.end(), later);
+}
+
+TiledNeighborhood::CliqueRuns::~CliqueRuns() = default;
+
+bool TiledNeighborhood::CliqueRuns::next(std::vector<InstanceId>& clique) {
+    // A head belongs to one tile, so ordering by head alone keeps the cliques
+    // of one head together and in the order of their run
+    const auto later = [this](size_t a, size_t b) { return runs[a]->current.front() > runs[b]->current.front(); };
+    if (heap.empty()) return false;
+    std::pop_heap(heap.begin(), heap.end(), later);
+    Run& run = *runs[heap.back()];
+    clique.swap(run.current);
+    if (readClique(run.in, run.current, run.path)) {
+        std::push_heap(heap.begin(), heap.end(), later);
+    } else {
+        heap.pop_back();
+    }
+    return true;
+}
+
+std::vector<std::vector<InstanceId>> TiledNeighborhood::runIds() const {
+    std::vector<std::vector<InstanceId>> cliques;
+    runIds([&cliques](const std::vector<InstanceId>& clique) { cliques.push_back(clique); });
+    return cliques;
+}
+
+void TiledNeighborhood::removeFiles() {
+    for (const Tile& tile : tileList) removeTileFiles(tile.path);
+    tileList.clear();
+}
@@ -1,35 +1,29 @@
 #include "utils.h"
 #include <algorithm>
+#include <iterator>
 #include <vector>
 
-std::vector<InstanceId> getIntersection(const std::vector<InstanceId>& v1, const std::vector<InstanceId>& v2) {
-    // Make copies to sort
-    std::vector<InstanceId> sorted_v1 = v1;
-    std::vector<InstanceId> sorted_v2 = v2;
-
-    std::sort(sorted_v1.begin(), sorted_v1.end());
-    std::sort(sorted_v2.begin(), sorted_v2.end());
-
+std::vector<InstanceId> getIntersection(InstanceSpan v1, InstanceSpan v2) {
+    // Inputs are already sorted by id, so a plain merge is enough
     std::vector<InstanceId> intersection;
     // Pre-allocate worst case size is technically min(v1, v2) but usually small
-    intersection.reserve(std::min(sorted_v1.size(), sorted_v2.size()));
+    intersection.reserve(std::min(v1.size(), v2.size()));
 
-    std::set_intersection(sorted_v1.begin(), sorted_v1.end(),
-                          sorted_v2.begin(), sorted_v2.end(),
+    std::set_intersection(v1.begin(), v1.end(),
+                          v2.begin(), v2.end(),
                           std::back_inserter(intersection));
 
     return intersection;
 }
-}
 
 #include <iostream>
 
 
 
-void printPattern(const Colocation& pattern) {
+void printPattern(const Colocation& pattern, const FeatureDictionary& features) {
     std::cout << "{ ";
     for (size_t i = 0; i < pattern.size(); ++i) {
-        std::cout << pattern[i] << (i < pattern.size() - 1 ? ", " : " ");
+        std::cout << features.name(pattern[i]) << (i < pattern.size() - 1 ? ", " : " ");
     }
     std::cout << "}";
 }
@@ -49,8 +43,8 @@ void Initialize_Itree(IDSNode*& root) {
     if (root) {
         deleteTree(root);
     }
-    // Root node ảo, không chứa instance cụ thể (id = -1 hoặc 0 tùy quy ước)
-    root = new IDSNode("ROOT"); // Changed from -1 to string for InstanceId compatibility
+    // Root node ảo, không chứa instance cụ thể
+    root = new IDSNode(INVALID_INSTANCE);
 }
 
 IDSNode* AddHeadNode(IDSNode* root, InstanceId s) {
@@ -70,11 +64,11 @@ std::vector<InstanceId> GetChildren(IDSNode* currNode, IDSNode* root, const Neig
     // 1. If currNode is a head-node (parent is root): Children are BNs(s)
     // 2. Otherwise (non-root): Children are BNs(s) ∩ RS(s)
 
-    std::vector<InstanceId> bns = neighbors_mgr.getBigNeighbors(currNode->instance_id);
+    InstanceSpan bns = neighbors_mgr.getBigNeighbors(currNode->instance_id);
 
     if (currNode->parent == root) {
         // Case 1: Head-node
-        return bns;
+        return std::vector<InstanceId>(bns.begin(), bns.end());
     } else {
         // Case 2: Non-head node
         // Lấy danh sách Right Siblings (RS) của currNode trên cây